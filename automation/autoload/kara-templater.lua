@@ -45,11 +45,10 @@ include("karaskel.lua")
 -- Find and parse/prepare all karaoke template lines
 function parse_templates(meta, styles, subs)
 	local templates = { once = {}, line = {}, syl = {}, char = {}, furi = {}, styles = {} }
-	local i = 1
-	while i <= #subs do
+	local old_fx = {}
+	for i = 1, #subs do
 		aegisub.progress.set((i-1) / #subs * 100)
 		local l = subs[i]
-		i = i + 1
 		if l.class == "dialogue" and l.comment then
 			local fx, mods = string.headtail(l.effect)
 			fx = fx:lower()
@@ -61,10 +60,12 @@ function parse_templates(meta, styles, subs)
 			templates.styles[l.style] = true
 		elseif l.class == "dialogue" and l.effect == "fx" then
 			-- this is a previously generated effect line, remove it
-			i = i - 1
-			subs.delete(i)
+			table.insert(old_fx, i)
 		end
 	end
+	-- deleting them all at once rather than one at a time avoids shifting
+	-- every following line down once per deleted line
+	subs.batch{delete = old_fx}
 	aegisub.progress.set(100)
 	return templates
 end
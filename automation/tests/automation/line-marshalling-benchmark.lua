@@ -0,0 +1,51 @@
+-- Automation 4 test file
+-- Time reading and writing back every dialogue line in the file, which is
+-- what most macros that operate on the whole file spend their time doing
+
+script_name = "TEST line marshalling speed"
+script_description = "Time iterating over and modifying every line of the file"
+script_author = "Aegisub"
+script_version = "1"
+
+function time_read(subs)
+    local start = os.clock()
+    local count = 0
+    for i = 1, #subs do
+        local line = subs[i]
+        if line.class == "dialogue" then
+            count = count + #line.text
+        end
+    end
+    aegisub.log(string.format("Read %d lines in %.3f seconds\n", #subs, os.clock() - start))
+end
+
+function time_modify(subs)
+    local start = os.clock()
+    for i = 1, #subs do
+        local line = subs[i]
+        if line.class == "dialogue" then
+            line.start_time = line.start_time + 10
+            line.end_time = line.end_time + 10
+            subs[i] = line
+        end
+    end
+    aegisub.log(string.format("Modified %d lines in %.3f seconds\n", #subs, os.clock() - start))
+    aegisub.set_undo_point("shift all lines")
+end
+
+function time_modify_text(subs)
+    local start = os.clock()
+    for i = 1, #subs do
+        local line = subs[i]
+        if line.class == "dialogue" then
+            line.text = line.text:gsub("\\N", " ")
+            subs[i] = line
+        end
+    end
+    aegisub.log(string.format("Modified the text of %d lines in %.3f seconds\n", #subs, os.clock() - start))
+    aegisub.set_undo_point("remove line breaks")
+end
+
+aegisub.register_macro("Line marshalling/Read all lines", "Time reading every line", time_read)
+aegisub.register_macro("Line marshalling/Shift all lines", "Time changing the times of every line", time_modify)
+aegisub.register_macro("Line marshalling/Edit all text", "Time changing the text of every line", time_modify_text)
@@ -0,0 +1,259 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/peaks.h"
+
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_PEAKS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+/// Identifies a saved pyramid, and changes whenever the format does
+const char file_magic[8] = {'A', 'G', 'I', 'P', 'E', 'A', 'K', '1'};
+}
+
+namespace agi {
+AudioPeak ComputeAudioPeak(const int16_t *samples, int64_t count) {
+	AudioPeak ret;
+	if (count <= 0) return ret;
+
+	int peak_min = 0, peak_max = 0;
+	int64_t sum_min = 0, sum_max = 0;
+	int64_t i = 0;
+
+#ifdef AGI_PEAKS_SSE2
+	if (count >= 8) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i vmin = zero, vmax = zero;
+
+		const int64_t simd_end = count & ~int64_t(7);
+		while (i < simd_end) {
+			// Each 32-bit lane of the sums grows by at most 2^16 per
+			// iteration, so flush them to the 64-bit totals before they can
+			// overflow
+			const int64_t chunk_end = std::min(simd_end, i + 8 * 16384);
+			__m128i vsum_min = zero, vsum_max = zero;
+			for (; i < chunk_end; i += 8) {
+				__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+				vmin = _mm_min_epi16(vmin, x);
+				vmax = _mm_max_epi16(vmax, x);
+				vsum_min = _mm_add_epi32(vsum_min, _mm_madd_epi16(_mm_min_epi16(x, zero), ones));
+				vsum_max = _mm_add_epi32(vsum_max, _mm_madd_epi16(_mm_max_epi16(x, zero), ones));
+			}
+
+			int32_t lanes[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vsum_min);
+			sum_min += int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vsum_max);
+			sum_max += int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		}
+
+		int16_t lanes[8];
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vmin);
+		peak_min = *std::min_element(lanes, lanes + 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vmax);
+		peak_max = *std::max_element(lanes, lanes + 8);
+	}
+#endif
+
+	for (; i < count; ++i) {
+		int sample = samples[i];
+		if (sample > 0) {
+			peak_max = std::max(peak_max, sample);
+			sum_max += sample;
+		}
+		else {
+			peak_min = std::min(peak_min, sample);
+			sum_min += sample;
+		}
+	}
+
+	ret.min = static_cast<int16_t>(peak_min);
+	ret.max = static_cast<int16_t>(peak_max);
+	ret.avg_min = static_cast<int16_t>(sum_min / count);
+	ret.avg_max = static_cast<int16_t>(sum_max / count);
+	return ret;
+}
+
+AudioPeakPyramid::AudioPeakPyramid(int64_t num_samples)
+: num_samples(std::max<int64_t>(num_samples, 0))
+{
+	size_t size = static_cast<size_t>((this->num_samples + bucket_size - 1) >> bucket_bits);
+	while (size > 0) {
+		levels.emplace_back(size);
+		if (size == 1) break;
+		size = (size + 1) / 2;
+	}
+	filled.resize(levels.size());
+}
+
+void AudioPeakPyramid::Push(AudioPeak const& peak) {
+	if (!levels.empty() && filled[0] < levels[0].size())
+		levels[0][filled[0]++] = peak;
+}
+
+void AudioPeakPyramid::Propagate(bool final) {
+	for (size_t level = 1; level < levels.size(); ++level) {
+		auto const& below = levels[level - 1];
+		size_t below_filled = filled[level - 1];
+		auto& cur = levels[level];
+
+		size_t &i = filled[level];
+		for (; 2 * i + 1 < below_filled; ++i) {
+			auto const& a = below[2 * i];
+			auto const& b = below[2 * i + 1];
+			cur[i].min = std::min(a.min, b.min);
+			cur[i].max = std::max(a.max, b.max);
+			cur[i].avg_min = static_cast<int16_t>((a.avg_min + b.avg_min) / 2);
+			cur[i].avg_max = static_cast<int16_t>((a.avg_max + b.avg_max) / 2);
+		}
+
+		// The last entry of an odd-sized level has only one child
+		if (final && i < cur.size() && 2 * i < below_filled) {
+			cur[i] = below[2 * i];
+			++i;
+		}
+	}
+
+	ready = final ? num_samples : std::min<int64_t>(filled.empty() ? 0 : filled[0] << bucket_bits, num_samples);
+}
+
+void AudioPeakPyramid::Add(const int16_t *samples, int64_t count) {
+	count = std::min(count, num_samples - added);
+	if (count <= 0) return;
+	added += count;
+
+	while (count > 0) {
+		if (pending_count > 0 || count < bucket_size) {
+			size_t to_copy = std::min<size_t>(count, bucket_size - pending_count);
+			memcpy(&pending[pending_count], samples, to_copy * sizeof(int16_t));
+			pending_count += to_copy;
+			samples += to_copy;
+			count -= to_copy;
+
+			if (pending_count == bucket_size) {
+				Push(ComputeAudioPeak(pending.data(), bucket_size));
+				pending_count = 0;
+			}
+			continue;
+		}
+
+		for (; count >= bucket_size; count -= bucket_size, samples += bucket_size)
+			Push(ComputeAudioPeak(samples, bucket_size));
+	}
+
+	bool final = added == num_samples;
+	if (final && pending_count > 0) {
+		Push(ComputeAudioPeak(pending.data(), pending_count));
+		pending_count = 0;
+	}
+	Propagate(final);
+}
+
+AudioPeak AudioPeakPyramid::Get(int64_t start, int64_t end) const {
+	AudioPeak ret;
+	if (levels.empty() || end <= start) return ret;
+
+	// Use the coarsest level which still has at least four entries in the range
+	size_t level = 0;
+	while (level + 1 < levels.size() && (bucket_size << (level + 1)) * 4 <= end - start)
+		++level;
+	const int shift = bucket_bits + static_cast<int>(level);
+
+	const int64_t available = ready;
+	start = std::max<int64_t>(start, 0);
+	end = std::min(end, available);
+	if (end <= start) return ret;
+
+	auto const& entries = levels[level];
+	size_t first = static_cast<size_t>(start >> shift);
+	size_t last = static_cast<size_t>(((end - 1) >> shift) + 1);
+	if (available < num_samples)
+		last = std::min(last, static_cast<size_t>(available >> shift));
+	last = std::min(last, entries.size());
+	if (first >= last) return ret;
+
+	int64_t sum_min = 0, sum_max = 0;
+	for (size_t i = first; i < last; ++i) {
+		ret.min = std::min(ret.min, entries[i].min);
+		ret.max = std::max(ret.max, entries[i].max);
+		sum_min += entries[i].avg_min;
+		sum_max += entries[i].avg_max;
+	}
+	ret.avg_min = static_cast<int16_t>(sum_min / int64_t(last - first));
+	ret.avg_max = static_cast<int16_t>(sum_max / int64_t(last - first));
+	return ret;
+}
+
+std::unique_ptr<AudioPeakPyramid> AudioPeakPyramid::Load(fs::path const& path, int64_t num_samples) {
+	if (!fs::FileExists(path)) return nullptr;
+
+	try {
+		auto pyramid = std::make_unique<AudioPeakPyramid>(num_samples);
+		auto stream = io::Open(path, true);
+
+		char magic[sizeof(file_magic)];
+		int64_t stored_samples = 0;
+		stream->read(magic, sizeof(magic));
+		stream->read(reinterpret_cast<char *>(&stored_samples), sizeof(stored_samples));
+		if (!*stream || memcmp(magic, file_magic, sizeof(magic)) || stored_samples != pyramid->num_samples)
+			return nullptr;
+
+		for (auto& level : pyramid->levels)
+			stream->read(reinterpret_cast<char *>(level.data()), level.size() * sizeof(AudioPeak));
+		if (!*stream)
+			return nullptr;
+
+		for (size_t i = 0; i < pyramid->levels.size(); ++i)
+			pyramid->filled[i] = pyramid->levels[i].size();
+		pyramid->added = pyramid->num_samples;
+		pyramid->ready = pyramid->num_samples;
+		return pyramid;
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio/peaks") << "failed to load " << path << ": " << e.GetMessage();
+		return nullptr;
+	}
+}
+
+bool AudioPeakPyramid::Save(fs::path const& path) const {
+	if (ready != num_samples) return false;
+
+	try {
+		io::Save file(path, true);
+		auto& stream = file.Get();
+		stream.write(file_magic, sizeof(file_magic));
+		stream.write(reinterpret_cast<const char *>(&num_samples), sizeof(num_samples));
+		for (auto const& level : levels)
+			stream.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(AudioPeak));
+		return !!stream;
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio/peaks") << "failed to save " << path << ": " << e.GetMessage();
+		return false;
+	}
+}
+}
@@ -16,6 +16,7 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
@@ -23,6 +24,7 @@
 
 #include <boost/interprocess/detail/os_thread_functions.hpp>
 #include <ctime>
+#include <mutex>
 #include <thread>
 
 namespace {
@@ -30,6 +32,10 @@ using namespace agi;
 
 class HDAudioProvider final : public AudioProviderWrapper {
 	mutable temp_file_mapping file;
+	/// Reading may replace the file's mapped view, so readers on different
+	/// threads have to take turns
+	mutable std::mutex read_mutex;
+	std::unique_ptr<AudioPeakPyramid> peaks;
 	std::atomic<bool> cancelled = {false};
 	std::thread decoder;
 
@@ -43,6 +49,7 @@ class HDAudioProvider final : public AudioProviderWrapper {
 		if (count > 0) {
 			start *= bytes_per_sample;
 			count *= bytes_per_sample;
+			std::lock_guard<std::mutex> lock(read_mutex);
 			memcpy(buf, file.read(start, count), count);
 		}
 	}
@@ -57,19 +64,33 @@ class HDAudioProvider final : public AudioProviderWrapper {
 	}
 
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& dir)
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& dir, fs::path const& peak_cache)
 	: AudioProviderWrapper(std::move(src))
 	, file(dir / CacheFilename(dir), num_samples * bytes_per_sample)
 	{
 		decoded_samples = 0;
-		decoder = std::thread([&] {
+		bool save_peaks = false;
+		if (channels == 1 && bytes_per_sample == 2 && !float_samples) {
+			if (!peak_cache.empty())
+				peaks = AudioPeakPyramid::Load(peak_cache, num_samples);
+			if (!peaks) {
+				peaks = std::make_unique<AudioPeakPyramid>(num_samples);
+				save_peaks = !peak_cache.empty();
+			}
+		}
+		decoder = std::thread([&, save_peaks, peak_cache] {
 			int64_t block = 65536;
 			for (int64_t i = 0; i < num_samples; i += block) {
 				if (cancelled) break;
 				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample, block * bytes_per_sample), i, block);
+				auto buf = file.write(i * bytes_per_sample, block * bytes_per_sample);
+				source->GetAudio(buf, i, block);
+				if (peaks)
+					peaks->Add(reinterpret_cast<const int16_t *>(buf), block);
 				decoded_samples += block;
 			}
+			if (save_peaks && !cancelled)
+				peaks->Save(peak_cache);
 		});
 	}
 
@@ -77,11 +98,13 @@ public:
 		cancelled = true;
 		decoder.join();
 	}
+
+	const AudioPeakPyramid *GetPeaks() const override { return peaks.get(); }
 };
 }
 
 namespace agi {
-std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return std::make_unique<HDAudioProvider>(std::move(src), dir);
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& peak_cache) {
+	return std::make_unique<HDAudioProvider>(std::move(src), dir, peak_cache);
 }
 }
@@ -16,6 +16,7 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include <libaegisub/audio/peaks.h>
 
 #include <array>
 #include <boost/container/stable_vector.hpp>
@@ -33,16 +34,26 @@ class RAMAudioProvider final : public AudioProviderWrapper {
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
+	std::unique_ptr<AudioPeakPyramid> peaks;
 	std::atomic<bool> cancelled = {false};
 	std::thread decoder;
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
 public:
-	RAMAudioProvider(std::unique_ptr<AudioProvider> src)
+	RAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache)
 	: AudioProviderWrapper(std::move(src))
 	{
 		decoded_samples = 0;
+		bool save_peaks = false;
+		if (channels == 1 && bytes_per_sample == 2 && !float_samples) {
+			if (!peak_cache.empty())
+				peaks = AudioPeakPyramid::Load(peak_cache, num_samples);
+			if (!peaks) {
+				peaks = std::make_unique<AudioPeakPyramid>(num_samples);
+				save_peaks = !peak_cache.empty();
+			}
+		}
 
 		try {
 			blockcache.resize((source->GetNumSamples() * source->GetBytesPerSample() + CacheBlockSize - 1) >> CacheBits);
@@ -51,14 +62,18 @@ public:
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
 
-		decoder = std::thread([&] {
+		decoder = std::thread([&, save_peaks, peak_cache] {
 			int64_t readsize = CacheBlockSize / source->GetBytesPerSample();
 			for (size_t i = 0; i < blockcache.size(); i++) {
 				if (cancelled) break;
 				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
 				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
+				if (peaks)
+					peaks->Add(reinterpret_cast<const int16_t *>(&blockcache[i][0]), actual_read);
 				decoded_samples += actual_read;
 			}
+			if (save_peaks && !cancelled)
+				peaks->Save(peak_cache);
 		});
 	}
 
@@ -66,6 +81,8 @@ public:
 		cancelled = true;
 		decoder.join();
 	}
+
+	const AudioPeakPyramid *GetPeaks() const override { return peaks.get(); }
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
@@ -89,7 +106,7 @@ void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const
 }
 
 namespace agi {
-std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
-	return std::make_unique<RAMAudioProvider>(std::move(src));
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache) {
+	return std::make_unique<RAMAudioProvider>(std::move(src), peak_cache);
 }
 }
@@ -18,6 +18,7 @@
 
 #include "libaegisub/util.h"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio/executor_work_guard.hpp>
 #include <boost/asio/io_context.hpp>
@@ -30,6 +31,7 @@ namespace {
 	boost::asio::io_context *service;
 	std::function<void (agi::dispatch::Thunk)> invoke_main;
 	std::atomic<uint_fast32_t> threads_running;
+	size_t thread_count = 1;
 
 	class MainQueue final : public agi::dispatch::Queue {
 		void DoInvoke(agi::dispatch::Thunk&& thunk) override {
@@ -81,6 +83,7 @@ void Init(std::function<void (Thunk)>&& invoke_main) {
 	::invoke_main = invoke_main;
 
 	thread_pool.threads.reserve(std::max<unsigned>(4, std::thread::hardware_concurrency()));
+	thread_count = thread_pool.threads.capacity();
 	for (size_t i = 0; i < thread_pool.threads.capacity(); ++i) {
 		thread_pool.threads.emplace_back([]{
 			++threads_running;
@@ -138,4 +141,61 @@ std::unique_ptr<Queue> Create() {
 	return std::unique_ptr<Queue>(new SerialQueue);
 }
 
+void ParallelFor(size_t count, std::function<void (size_t)> const& func) {
+	if (count == 0) return;
+
+	// Split the work into a few chunks per thread so that uneven items
+	// balance out, and have each worker claim chunks until there are none left
+	struct State {
+		std::function<void (size_t)> const* func;
+		size_t count;
+		size_t chunk_size;
+		size_t chunks;
+		std::atomic<size_t> next_chunk{0};
+		std::atomic<bool> failed{false};
+		std::mutex m;
+		std::condition_variable cv;
+		size_t chunks_done = 0;
+		std::exception_ptr error;
+
+		void Work() {
+			for (size_t chunk; (chunk = next_chunk++) < chunks; ) {
+				// func may be gone once the last chunk is done, so only
+				// touch it while this chunk is outstanding
+				if (!failed) {
+					try {
+						size_t end = std::min(count, (chunk + 1) * chunk_size);
+						for (size_t i = chunk * chunk_size; i < end && !failed; ++i)
+							(*func)(i);
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> lock(m);
+						if (!error) error = std::current_exception();
+						failed = true;
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(m);
+				if (++chunks_done == chunks)
+					cv.notify_all();
+			}
+		}
+	};
+
+	auto state = std::make_shared<State>();
+	state->func = &func;
+	state->count = count;
+	state->chunk_size = std::max<size_t>(1, count / (thread_count * 4));
+	state->chunks = (count + state->chunk_size - 1) / state->chunk_size;
+
+	size_t helpers = std::min(thread_count, state->chunks - 1);
+	for (size_t i = 0; i < helpers; ++i)
+		boost::asio::post(*service, [state] { state->Work(); });
+	state->Work();
+
+	std::unique_lock<std::mutex> lock(state->m);
+	state->cv.wait(lock, [&] { return state->chunks_done == state->chunks; });
+	if (state->error) std::rethrow_exception(state->error);
+}
+
 }
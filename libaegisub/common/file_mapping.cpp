@@ -69,6 +69,26 @@ char *map(int64_t s_offset, uint64_t length, boost::interprocess::mode_t mode,
 	return static_cast<char *>(region->get_address()) + offset - mapping_start;
 }
 
+void set_file_size(agi::file_mapping const& file, agi::fs::path const& filename, uint64_t size) {
+	auto handle = file.get_mapping_handle().handle;
+#ifdef _WIN32
+	LARGE_INTEGER li;
+	li.QuadPart = size;
+	SetFilePointerEx(handle, li, nullptr, FILE_BEGIN);
+	SetEndOfFile(handle);
+#else
+	if (ftruncate(handle, size) == -1) {
+		switch (errno) {
+		case EBADF:  throw agi::InternalError("Error opening file " + filename.string() + " not handled");
+		case EFBIG:  throw agi::fs::DriveFull(filename);
+		case EINVAL: throw agi::InternalError("File opened incorrectly: " + filename.string());
+		case EROFS:  throw agi::fs::WriteDenied(filename);
+		default: throw agi::fs::FileSystemUnknownError("Unknown error opening file: " + filename.string());
+		}
+	}
+#endif
+}
+
 }
 
 namespace agi {
@@ -138,24 +158,10 @@ temp_file_mapping::temp_file_mapping(agi::fs::path const& filename, uint64_t siz
 : file(filename, true)
 , file_size(size)
 {
-	auto handle = file.get_mapping_handle().handle;
-#ifdef _WIN32
-	LARGE_INTEGER li;
-	li.QuadPart = size;
-	SetFilePointerEx(handle, li, nullptr, FILE_BEGIN);
-	SetEndOfFile(handle);
-#else
+#ifndef _WIN32
 	unlink(filename.string().c_str());
-	if (ftruncate(handle, size) == -1) {
-		switch (errno) {
-		case EBADF:  throw InternalError("Error opening file " + filename.string() + " not handled");
-		case EFBIG:  throw fs::DriveFull(filename);
-		case EINVAL: throw InternalError("File opened incorrectly: " + filename.string());
-		case EROFS:  throw fs::WriteDenied(filename);
-		default: throw fs::FileSystemUnknownError("Unknown error opening file: " + filename.string());
-		}
-	}
 #endif
+	set_file_size(file, filename, size);
 }
 
 temp_file_mapping::~temp_file_mapping() = default;
@@ -167,4 +173,26 @@ const char *temp_file_mapping::read(int64_t offset, uint64_t length) {
 char *temp_file_mapping::write(int64_t offset, uint64_t length) {
 	return map(offset, length, read_write, file_size, file, write_region, write_mapping_start);
 }
+
+persistent_file_mapping::persistent_file_mapping(agi::fs::path const& filename, uint64_t size)
+: file(filename, true)
+, file_size(size)
+{
+	set_file_size(file, filename, size);
+	if (size > std::numeric_limits<size_t>::max())
+		throw std::bad_alloc();
+
+	try {
+		region = std::make_unique<mapped_region>(file, read_write, 0, static_cast<size_t>(size));
+	}
+	catch (interprocess_exception const&) {
+		throw agi::fs::FileSystemUnknownError("Failed mapping a view of the file");
+	}
+}
+
+persistent_file_mapping::~persistent_file_mapping() = default;
+
+char *persistent_file_mapping::data() {
+	return static_cast<char *>(region->get_address());
+}
 }
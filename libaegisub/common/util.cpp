@@ -34,6 +34,14 @@ namespace {
 const size_t bad_pos = (size_t)-1;
 const std::pair bad_match(bad_pos, bad_pos);
 
+bool is_ascii(std::string_view str) {
+	for (char c : str) {
+		if (c & 0x80)
+			return false;
+	}
+	return true;
+}
+
 std::pair<size_t, size_t> find_range(std::string const& haystack, std::string const& needle, size_t start = 0) {
 	const size_t match_start = haystack.find(needle, start);
 	if (match_start == std::string::npos)
@@ -85,9 +93,23 @@ std::string fold_case(std::string_view str, icu::Edits *edits) {
 }
 
 std::pair<size_t, size_t> ifind(std::string const& haystack, std::string const& needle) {
+	const auto folded_n = fold_case(needle, nullptr);
+
+	// Folding ASCII just lowercases it without changing any offsets, so the
+	// common case of an ASCII line doesn't need to go through ICU
+	if (is_ascii(haystack)) {
+		if (!is_ascii(folded_n))
+			return bad_match;
+		std::string lowered = haystack;
+		for (auto& c : lowered) {
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+		}
+		return find_range(lowered, folded_n);
+	}
+
 	icu::Edits edits;
 	const auto folded_hs = fold_case(haystack, &edits);
-	const auto folded_n = fold_case(needle, nullptr);
 	auto it = edits.getFineIterator();
 	size_t pos = 0;
 	while (true) {
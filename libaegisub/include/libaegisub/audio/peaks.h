@@ -0,0 +1,106 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/fs.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace agi {
+/// Summary of a range of mono 16-bit samples, as drawn by the waveform display
+struct AudioPeak {
+	/// Most negative sample, or zero if there are none
+	int16_t min = 0;
+	/// Most positive sample, or zero if there are none
+	int16_t max = 0;
+	/// Sum of the negative samples divided by the total number of samples
+	int16_t avg_min = 0;
+	/// Sum of the positive samples divided by the total number of samples
+	int16_t avg_max = 0;
+};
+
+/// Summarize count samples
+AudioPeak ComputeAudioPeak(const int16_t *samples, int64_t count);
+
+/// @class AudioPeakPyramid
+/// @brief Multi-resolution summary of a mono 16-bit audio stream
+///
+/// The bottom level has one AudioPeak for each bucket_size samples, and each
+/// level above it has one for each two in the level below. This is built by
+/// the caching audio providers as they decode the audio, and lets the
+/// waveform be drawn at any zoom level above bucket_size samples per pixel
+/// by looking at a handful of precomputed values per pixel.
+///
+/// Add() may be called from one thread while any number of others call Get().
+class AudioPeakPyramid {
+public:
+	static constexpr int bucket_bits = 8;
+	/// Number of samples summarized by each entry in the bottom level
+	static constexpr int64_t bucket_size = int64_t(1) << bucket_bits;
+
+private:
+	std::vector<std::vector<AudioPeak>> levels;
+	/// Number of entries in each level which have been filled in
+	std::vector<size_t> filled;
+	/// Samples which have been passed to Add() but not yet summarized
+	std::array<int16_t, bucket_size> pending;
+	size_t pending_count = 0;
+	/// Total number of samples passed to Add()
+	int64_t added = 0;
+	/// Total number of samples in the stream
+	int64_t num_samples;
+	/// Number of samples whose summary is available to readers
+	std::atomic<int64_t> ready{0};
+
+	void Push(AudioPeak const& peak);
+	void Propagate(bool final);
+
+public:
+	/// @param num_samples Total number of samples which will be added
+	AudioPeakPyramid(int64_t num_samples);
+
+	/// Add the next count samples of the stream
+	void Add(const int16_t *samples, int64_t count);
+
+	/// Summarize the samples in [start, end)
+	///
+	/// The range is widened to the boundaries of the entries used, which are
+	/// picked so that they are at most a quarter the size of the range where
+	/// possible. Samples which have not been added yet are treated as silence.
+	AudioPeak Get(int64_t start, int64_t end) const;
+
+	/// Number of samples which are included in the results of Get()
+	int64_t GetReadySamples() const { return ready; }
+
+	/// @brief Load a pyramid previously written by Save()
+	/// @param path        File to load from
+	/// @param num_samples Number of samples in the stream the pyramid is for
+	/// @return The loaded pyramid, or null if the file doesn't exist, can't
+	///         be read, or is for a different number of samples
+	static std::unique_ptr<AudioPeakPyramid> Load(fs::path const& path, int64_t num_samples);
+
+	/// @brief Write the pyramid to a file
+	/// @return Whether the file was written
+	///
+	/// Must only be called once all of the samples have been added.
+	bool Save(fs::path const& path) const;
+};
+}
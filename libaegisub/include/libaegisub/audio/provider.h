@@ -24,6 +24,8 @@
 #include <vector>
 
 namespace agi {
+class AudioPeakPyramid;
+
 class AudioProvider {
 protected:
 	int channels = 0;
@@ -55,6 +57,9 @@ public:
 
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Get the waveform summary of the decoded audio, if this provider builds one
+	virtual const AudioPeakPyramid *GetPeaks() const { return nullptr; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -89,9 +94,14 @@ std::unique_ptr<AudioProvider> CreatePCMAudioProvider(agi::fs::path const& filen
 
 std::unique_ptr<AudioProvider> CreateConvertAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+/// The cache providers build an AudioPeakPyramid as they decode. If peak_cache
+/// is not empty, it is loaded from that file if possible rather than being
+/// built, and is saved there once decoding is complete.
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider,
-                                                     agi::fs::path const& dir);
-std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+                                                     agi::fs::path const& dir,
+                                                     agi::fs::path const& peak_cache = {});
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider,
+                                                      agi::fs::path const& peak_cache = {});
 
 void SaveAudioClip(AudioProvider const& provider, agi::fs::path const& path, int start_time, int end_time);
 }
@@ -14,6 +14,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 
@@ -45,4 +46,14 @@ Queue& Background();
 
 /// Create a new serial queue
 std::unique_ptr<Queue> Create();
+
+/// @brief Call func(i) for each i in [0, count) using the background queue
+///
+/// The calling thread does some of the work as well, and this returns once
+/// every call has finished, so func can safely refer to the caller's locals.
+/// The calls are made in no particular order and may run concurrently, so
+/// each should only write to state belonging to its own index. If any of
+/// them throws, the remaining calls are skipped and the first exception is
+/// rethrown.
+void ParallelFor(size_t count, std::function<void (size_t)> const& func);
 }
@@ -67,4 +67,23 @@ namespace agi {
 		const char *read(int64_t offset, uint64_t length);
 		char *write(int64_t offset, uint64_t length);
 	};
+
+	/// A file which is mapped in its entirety for reading and writing, and
+	/// which is left in place when closed
+	class persistent_file_mapping {
+		file_mapping file;
+		uint64_t file_size = 0;
+		std::unique_ptr<boost::interprocess::mapped_region> region;
+
+	public:
+		/// Open the file, creating it if needed, and resize it to size bytes
+		///
+		/// The existing contents are kept if the file was already that size,
+		/// and any newly added space is zero-filled.
+		persistent_file_mapping(agi::fs::path const& filename, uint64_t size);
+		~persistent_file_mapping();
+
+		uint64_t size() const { return file_size; }
+		char *data();
+	};
 }
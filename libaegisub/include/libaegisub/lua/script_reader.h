@@ -21,8 +21,14 @@ struct lua_State;
 
 namespace agi::lua {
 	/// Load a Lua or Moonscript file at the given path
+	///
+	/// If the state has a bytecode cache, the compiled file is loaded from
+	/// there when the file hasn't changed since it was cached, and added to
+	/// it otherwise.
 	bool LoadFile(lua_State *L, agi::fs::path const& filename);
 	/// Install our module loader and add include_path to the module search
 	/// path of the given lua state
-	bool Install(lua_State *L, std::vector<agi::fs::path> const& include_path);
+	/// @param cache_dir Directory to cache compiled scripts and modules in,
+	///                  or empty to always compile them
+	bool Install(lua_State *L, std::vector<agi::fs::path> const& include_path, agi::fs::path const& cache_dir = {});
 }
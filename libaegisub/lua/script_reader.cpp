@@ -17,12 +17,157 @@
 #include "libaegisub/lua/script_reader.h"
 
 #include "libaegisub/file_mapping.h"
+#include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/lua/utils.h"
 #include "libaegisub/split.h"
+#include "libaegisub/string.h"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/crc.hpp>
+#include <chrono>
+#include <cstring>
 #include <lauxlib.h>
+#include <mutex>
+
+namespace {
+using namespace agi;
+
+/// Identifies a bytecode cache file, and changes whenever the format does
+const char cache_magic[8] = {'A', 'G', 'I', 'L', 'U', 'A', 'C', '1'};
+
+/// Scripts are loaded in parallel and share include modules, so writes to
+/// the cache have to be serialized
+std::mutex cache_write_lock;
+
+/// MoonScript line number mapping for a compiled file, as pairs of Lua line
+/// number and character offset into the MoonScript source
+using LineTable = std::vector<std::pair<int32_t, int32_t>>;
+
+int append_chunk(lua_State *, const void *p, size_t size, void *ud) {
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), size);
+	return 0;
+}
+
+/// Get the cache file for a script, or an empty path if caching is disabled
+///
+/// The name covers the path, size and modification time of the script so
+/// that edited scripts are never even looked up under their old entry.
+fs::path CachePath(lua_State *L, fs::path const& filename) {
+	lua_getfield(L, LUA_REGISTRYINDEX, "bytecode cache");
+	fs::path dir;
+	if (lua_isstring(L, -1))
+		dir = lua_tostring(L, -1);
+	lua_pop(L, 1);
+	if (dir.empty()) return dir;
+
+	try {
+		boost::crc_32_type hash;
+		hash.process_bytes(filename.string().c_str(), filename.string().size());
+		auto modified_time = std::chrono::duration_cast<std::chrono::seconds>(fs::ModifiedTime(filename).time_since_epoch()).count();
+		return dir/Str(std::to_string(hash.checksum()), "_", std::to_string(fs::Size(filename)), "_", std::to_string(modified_time), ".luac");
+	}
+	catch (Exception const& e) {
+		LOG_D("auto4/lua/cache") << "not caching " << filename << ": " << e.GetMessage();
+		return {};
+	}
+}
+
+/// Load a chunk written by SaveCached
+/// @return Was the chunk loaded? Nothing is left on the stack if not.
+bool LoadCached(lua_State *L, fs::path const& path, uint32_t source_crc, std::string const& chunkname, LineTable &line_table) {
+	if (!fs::FileExists(path)) return false;
+
+	try {
+		read_file_mapping file(path);
+		auto size = static_cast<size_t>(file.size());
+		auto data = file.read();
+
+		const size_t header_size = sizeof(cache_magic) + 2 * sizeof(uint32_t);
+		uint32_t crc, count;
+		if (size < header_size || memcmp(data, cache_magic, sizeof(cache_magic))) return false;
+		memcpy(&crc, data + sizeof(cache_magic), sizeof(crc));
+		memcpy(&count, data + sizeof(cache_magic) + sizeof(crc), sizeof(count));
+		if (crc != source_crc || (size - header_size) / (2 * sizeof(int32_t)) < count) return false;
+
+		line_table.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			memcpy(&line_table[i].first, data + header_size + i * 2 * sizeof(int32_t), sizeof(int32_t));
+			memcpy(&line_table[i].second, data + header_size + (i * 2 + 1) * sizeof(int32_t), sizeof(int32_t));
+		}
+
+		size_t offset = header_size + count * 2 * sizeof(int32_t);
+		if (luaL_loadbuffer(L, data + offset, size - offset, chunkname.c_str())) {
+			// Most likely written by a different version of LuaJIT
+			LOG_D("auto4/lua/cache") << "discarding " << path << ": " << lua_tostring(L, -1);
+			lua_pop(L, 1);
+			return false;
+		}
+		return true;
+	}
+	catch (Exception const& e) {
+		LOG_D("auto4/lua/cache") << "failed to read " << path << ": " << e.GetMessage();
+		return false;
+	}
+}
+
+/// Write the function on the top of the stack to the cache
+void SaveCached(lua_State *L, fs::path const& path, uint32_t source_crc, LineTable const& line_table) {
+	std::string bytecode;
+	if (lua_dump(L, append_chunk, &bytecode) || bytecode.empty()) return;
+
+	try {
+		std::lock_guard<std::mutex> lock(cache_write_lock);
+		fs::CreateDirectory(path.parent_path());
+		io::Save file(path, true);
+		auto& out = file.Get();
+		auto count = static_cast<uint32_t>(line_table.size());
+		out.write(cache_magic, sizeof(cache_magic));
+		out.write(reinterpret_cast<const char *>(&source_crc), sizeof(source_crc));
+		out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		for (auto const& entry : line_table) {
+			out.write(reinterpret_cast<const char *>(&entry.first), sizeof(entry.first));
+			out.write(reinterpret_cast<const char *>(&entry.second), sizeof(entry.second));
+		}
+		out.write(bytecode.data(), bytecode.size());
+	}
+	catch (Exception const& e) {
+		LOG_D("auto4/lua/cache") << "failed to write " << path << ": " << e.GetMessage();
+	}
+}
+
+/// Get the line table MoonScript made when compiling a file
+LineTable GetLineTable(lua_State *L, std::string const& chunkname) {
+	LineTable ret;
+	if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
+		lua_pop(L, 1); // pop error message
+		return ret;
+	}
+
+	lua_getfield(L, -1, chunkname.c_str());
+	if (lua_istable(L, -1)) {
+		lua_pushnil(L);
+		while (lua_next(L, -2)) {
+			if (lua_isnumber(L, -2) && lua_isnumber(L, -1))
+				ret.emplace_back(static_cast<int32_t>(lua_tointeger(L, -2)), static_cast<int32_t>(lua_tointeger(L, -1)));
+			lua_pop(L, 1);
+		}
+	}
+	lua_pop(L, 2);
+	return ret;
+}
+
+/// Store the line table for a file loaded from the cache where the error
+/// handler can find it, as MoonScript never saw the file
+void SetLineTable(lua_State *L, std::string const& chunkname, LineTable const& line_table) {
+	lua_createtable(L, 0, static_cast<int>(line_table.size()));
+	for (auto const& entry : line_table) {
+		lua_pushinteger(L, entry.second);
+		lua_rawseti(L, -2, entry.first);
+	}
+	lua_setfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + chunkname).c_str());
+}
+}
 
 namespace agi::lua {
 	bool LoadFile(lua_State *L, agi::fs::path const& raw_filename) {
@@ -44,31 +189,68 @@ namespace agi::lua {
 			size -= 3;
 		}
 
-		if (!agi::fs::HasExtension(filename, "moon"))
-			return luaL_loadbuffer(L, buff, size, filename.string().c_str()) == 0;
+		auto chunkname = filename.string();
+		bool moon = agi::fs::HasExtension(filename, "moon");
+
+		if (moon) {
+			// Save the text we'll be loading for the line number rewriting in
+			// the error handling
+			lua_pushlstring(L, buff, size);
+			lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + chunkname).c_str());
+		}
+
+		auto cache_path = CachePath(L, filename);
+		uint32_t crc = 0;
+		if (!cache_path.empty()) {
+			boost::crc_32_type hash;
+			hash.process_bytes(buff, size);
+			crc = hash.checksum();
+
+			LineTable line_table;
+			if (LoadCached(L, cache_path, crc, chunkname, line_table)) {
+				if (moon)
+					SetLineTable(L, chunkname, line_table);
+				return true;
+			}
+		}
+
+		if (!moon) {
+			if (luaL_loadbuffer(L, buff, size, chunkname.c_str()))
+				return false;
+			if (!cache_path.empty())
+				SaveCached(L, cache_path, crc, {});
+			return true;
+		}
 
 		// We have a MoonScript file, so we need to load it with that
 		// It might be nice to have a dedicated lua state for compiling
 		// MoonScript to Lua
 		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		if (lua_isnil(L, -1)) {
+			// The compiler is only loaded once something needs compiling, as
+			// loading it is most of the cost of starting a script
+			lua_pop(L, 1);
+			luaL_loadstring(L, "return require('moonscript').loadstring");
+			if (lua_pcall(L, 0, 1, 0))
+				return false; // leave error message
+			lua_pushvalue(L, -1);
+			lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
+		}
 
-		// Save the text we'll be loading for the line number rewriting in the
-		// error handling
 		lua_pushlstring(L, buff, size);
-		lua_pushvalue(L, -1);
-		lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + filename.string()).c_str());
-
 		push_value(L, filename);
 		if (lua_pcall(L, 2, 2, 0))
 			return false; // Leaves error message on stack
 
 		// loadstring returns nil, error on error or a function on success
-		if (lua_isnil(L, 1)) {
-			lua_remove(L, 1);
+		if (lua_isnil(L, -2)) {
+			lua_remove(L, -2);
 			return false;
 		}
 
 		lua_pop(L, 1); // Remove the extra nil for the stackchecker
+		if (!cache_path.empty())
+			SaveCached(L, cache_path, crc, GetLineTable(L, chunkname));
 		return true;
 	}
 
@@ -119,7 +301,7 @@ namespace agi::lua {
 		return lua_gettop(L) - pretop;
 	}
 
-	bool Install(lua_State *L, std::vector<fs::path> const& include_path) {
+	bool Install(lua_State *L, std::vector<fs::path> const& include_path, fs::path const& cache_dir) {
 		// set the module load path to include_path
 		lua_getglobal(L, "package");
 		push_value(L, "path");
@@ -154,11 +336,10 @@ namespace agi::lua {
 		}
 #endif
 
-		luaL_loadstring(L, "return require('moonscript').loadstring");
-		if (lua_pcall(L, 0, 1, 0)) {
-			return false; // leave error message
+		if (!cache_dir.empty()) {
+			push_value(L, cache_dir);
+			lua_setfield(L, LUA_REGISTRYINDEX, "bytecode cache");
 		}
-		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
 
 		return true;
 	}
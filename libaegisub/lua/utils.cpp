@@ -88,28 +88,42 @@ void *check_udata(lua_State *L, int idx, const char *mt) {
 	return p;
 }
 
-static int moon_line(lua_State *L, int lua_line, std::string const& file) {
+/// Push the MoonScript line table for a file, if there is one
+static bool push_moon_line_table(lua_State *L, std::string const& file) {
+	// Files loaded from the bytecode cache weren't compiled by MoonScript in
+	// this state, so their line tables are stored separately
+	lua_getfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + file).c_str());
+	if (lua_istable(L, -1))
+		return true;
+	lua_pop(L, 1);
+
 	if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
 		lua_pop(L, 1); // pop error message
-		return lua_line;
+		return false;
 	}
 
 	push_value(L, file);
 	lua_rawget(L, -2);
+	lua_remove(L, -2);
 
-	if (!lua_istable(L, -1)) {
-		lua_pop(L, 2);
+	if (lua_istable(L, -1))
+		return true;
+	lua_pop(L, 1);
+	return false;
+}
+
+static int moon_line(lua_State *L, int lua_line, std::string const& file) {
+	if (!push_moon_line_table(L, file))
 		return lua_line;
-	}
 
 	lua_rawgeti(L, -1, lua_line);
 	if (!lua_isnumber(L, -1)) {
-		lua_pop(L, 3);
+		lua_pop(L, 2);
 		return lua_line;
 	}
 
 	auto char_pos = static_cast<size_t>(lua_tonumber(L, -1));
-	lua_pop(L, 3);
+	lua_pop(L, 2);
 
 	// The moonscript line tables give us a character offset into the file,
 	// so now we need to map that to a line number
@@ -26,9 +26,9 @@
 // Out-of-line to anchor vtable
 AssEntryGroup AssAttachment::Group() const { return group; }
 
-AssAttachment::AssAttachment(std::string const& header, AssEntryGroup group)
-: entry_data(header + "\r\n")
-, filename(header.substr(10))
+AssAttachment::AssAttachment(std::string_view header, std::string_view data, AssEntryGroup group)
+: entry_data(agi::Str(header, "\r\n", data))
+, filename(std::string(header.substr(10)))
 , group(group)
 {
 }
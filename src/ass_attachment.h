@@ -18,6 +18,7 @@
 
 #include <boost/flyweight.hpp>
 #include <libaegisub/fs.h>
+#include <string_view>
 
 /// @class AssAttachment
 class AssAttachment final : public AssEntry {
@@ -33,9 +34,6 @@ public:
 	/// Get the size of the attached file in bytes
 	size_t GetSize() const;
 
-	/// Add a line of data (without newline) read from a subtitle file
-	void AddData(std::string const& data) { entry_data = entry_data.get() + data + "\r\n"; }
-
 	/// Extract the contents of this attachment to a file
 	/// @param filename Path to save the attachment to
 	void Extract(agi::fs::path const& filename) const;
@@ -47,6 +45,10 @@ public:
 	std::string const& GetEntryData() const { return entry_data; }
 	AssEntryGroup Group() const override;
 
-	AssAttachment(std::string const& header, AssEntryGroup group);
+	/// @brief Create an attachment read from a subtitle file
+	/// @param header First line of the attachment, without newline
+	/// @param data   Encoded lines of the attachment, each followed by \r\n
+	/// @param group  Section the attachment is from
+	AssAttachment(std::string_view header, std::string_view data, AssEntryGroup group);
 	AssAttachment(agi::fs::path const& name, AssEntryGroup group);
 };
@@ -31,12 +31,13 @@
 #include "subtitle_format.h"
 #include "utils.h"
 
-#include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
 #include <libaegisub/string.h>
 
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/range/adaptor/transformed.hpp>
 #include <boost/regex.hpp>
 #include <boost/spirit/include/karma_generate.hpp>
 #include <boost/spirit/include/karma_int.hpp>
@@ -44,7 +45,8 @@
 
 using namespace boost::adaptors;
 
-static int next_id = 0;
+// Lines are parsed in parallel when loading files
+static std::atomic<int> next_id{0};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
@@ -59,7 +61,7 @@ AssDialogue::AssDialogue(AssDialogue const& that)
 
 AssDialogue::AssDialogue(AssDialogueBase const& that) : AssDialogueBase(that) { }
 
-AssDialogue::AssDialogue(std::string const& data) {
+AssDialogue::AssDialogue(std::string_view data) {
 	Id = ++next_id;
 	Parse(data);
 }
@@ -83,7 +85,7 @@ public:
 	std::string next_str_trim() { return std::string(agi::Trim(next_tok())); }
 };
 
-void AssDialogue::Parse(std::string const& raw) {
+void AssDialogue::Parse(std::string_view raw) {
 	std::string_view str = raw;
 	if (raw.starts_with("Dialogue:")) {
 		Comment = false;
@@ -96,7 +98,7 @@ void AssDialogue::Parse(std::string const& raw) {
 		str.remove_prefix(std::min<size_t>(raw.size(), 9));
 	}
 	else
-		throw SubtitleFormatParseError("Failed parsing line: " + raw);
+		throw SubtitleFormatParseError(agi::Str("Failed parsing line: ", raw));
 
 	tokenizer tkn(str);
 
@@ -161,9 +163,14 @@ static void append_unsafe_str(std::string &out, std::string const& str) {
 }
 
 std::string AssDialogue::GetEntryData() const {
-	std::string str = Comment ? "Comment: " : "Dialogue: ";
-	str.reserve(51 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
+	std::string str;
+	str.reserve(61 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
+	AppendEntryData(str);
+	return str;
+}
 
+void AssDialogueBase::AppendEntryData(std::string &str) const {
+	str += Comment ? "Comment: " : "Dialogue: ";
 	append_int(str, Layer);
 	append_str(str, Start.GetAssFormatted());
 	append_str(str, End.GetAssFormatted());
@@ -186,8 +193,6 @@ std::string AssDialogue::GetEntryData() const {
 		if (c != '\n' && c != '\r')
 			str += c;
 	}
-
-	return str;
 }
 
 std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
@@ -275,8 +280,14 @@ bool AssDialogue::CollidesWith(const AssDialogue *target) const {
 	return ((Start < target->Start) ? (target->Start < End) : (Start < target->End));
 }
 
-static std::string get_text_p(AssDialogueBlock *d) { return d->GetText(); }
 std::string AssDialogue::GetStrippedText() const {
-	auto blocks = ParseTags();
-	return agi::Join("", blocks | agi::of_type<AssDialogueBlockPlain>() | transformed(get_text_p));
+	AssTagTree tree;
+	ParseTags(tree);
+
+	std::string stripped;
+	for (auto const& block : tree.Blocks()) {
+		if (block.type == AssBlockType::PLAIN)
+			stripped += block.text;
+	}
+	return stripped;
 }
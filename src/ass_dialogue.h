@@ -34,6 +34,9 @@
 
 #include <array>
 #include <boost/flyweight.hpp>
+#include <cstdint>
+#include <span>
+#include <string_view>
 #include <vector>
 
 enum class AssBlockType {
@@ -116,6 +119,79 @@ public:
 	void ProcessParameters(ProcessParametersCallback callback, void *userData);
 };
 
+/// @class AssTagTree
+/// @brief Flat, read-only parse of the blocks and override tags of a line
+///
+/// This is a cheaper alternative to AssDialogue::ParseTags() for code which
+/// only needs to look at the tags. The blocks, tags and parameters are each
+/// stored in a single array owned by the tree, and all of the strings are
+/// views into the parsed text, so the text must outlive the tree. Reusing a
+/// tree for multiple lines avoids allocating once its arrays have grown large
+/// enough.
+///
+/// Unlike AssOverrideParameter, the contents of \t blocks are parsed along
+/// with the rest of the line.
+class AssTagTree {
+public:
+	struct Parameter {
+		/// Text of the parameter, which is empty if it was omitted
+		std::string_view value;
+		VariableDataType type;
+		AssParameterClass classification;
+		bool omitted;
+		/// Tags in the block, for parameters of type BLOCK
+		uint32_t first_tag = 0;
+		uint32_t tag_count = 0;
+
+		template<class T> T Get() const;
+		template<class T> T Get(T def) const {
+			return !omitted ? Get<T>() : def;
+		}
+	};
+
+	struct Tag {
+		/// Name of the tag with slash, or the full text of an invalid tag
+		std::string_view name;
+		bool valid;
+		uint32_t first_param;
+		uint32_t param_count;
+	};
+
+	struct Block {
+		AssBlockType type;
+		/// Text of the block, which for comments includes the braces and for
+		/// override blocks does not
+		std::string_view text;
+		/// Scale of drawing blocks
+		int scale;
+		uint32_t first_tag;
+		uint32_t tag_count;
+	};
+
+private:
+	std::vector<Block> blocks;
+	std::vector<Tag> tags;
+	std::vector<Parameter> params;
+	/// Scratch space for splitting a tag's parameters
+	std::vector<std::string_view> tokens;
+
+	void ParseBlock(std::string_view text, uint32_t &first_tag, uint32_t &tag_count);
+	void AppendTags(std::string &out, uint32_t first_tag, uint32_t tag_count) const;
+
+public:
+	/// Parse text in the same way as AssDialogue::ParseTags()
+	void Parse(std::string_view text);
+
+	std::span<const Block> Blocks() const { return blocks; }
+	std::span<const Tag> Tags(Block const& block) const { return {tags.data() + block.first_tag, block.tag_count}; }
+	std::span<const Tag> Tags(Parameter const& param) const { return {tags.data() + param.first_tag, param.tag_count}; }
+	std::span<const Parameter> Params(Tag const& tag) const { return {params.data() + tag.first_param, tag.param_count}; }
+
+	/// Get the text of the line, which is the same as the text AssDialogue::UpdateText()
+	/// gives for the unmodified result of AssDialogue::ParseTags()
+	std::string GetText() const;
+};
+
 struct AssDialogueBase {
 	/// Unique ID of this line. Copies of the line for Undo/Redo purposes
 	/// preserve the unique ID, so that the equivalent lines can be found in
@@ -144,17 +220,23 @@ struct AssDialogueBase {
 	boost::flyweight<std::vector<uint32_t>> ExtradataIds;
 	/// Raw text data
 	boost::flyweight<std::string> Text;
+
+	/// Append the line in the form it has in ASS files, without a newline
+	void AppendEntryData(std::string &str) const;
 };
 
 class AssDialogue final : public AssEntry, public AssDialogueBase, public AssEntryListHook {
 	/// @brief Parse raw ASS data into everything else
 	/// @param data ASS line
-	void Parse(std::string const& data);
+	void Parse(std::string_view data);
 public:
 	AssEntryGroup Group() const override { return AssEntryGroup::DIALOGUE; }
 
 	/// Parse text as ASS and return block information
 	std::vector<std::unique_ptr<AssDialogueBlock>> ParseTags() const;
+	/// Parse text as ASS into tree, which refers to this line's text and so
+	/// is invalidated when the text is changed
+	void ParseTags(AssTagTree &tree) const { tree.Parse(Text.get()); }
 
 	/// Strip all ASS tags from the text
 	void StripTags();
@@ -172,7 +254,7 @@ public:
 	AssDialogue();
 	AssDialogue(AssDialogue const&);
 	AssDialogue(AssDialogueBase const&);
-	AssDialogue(std::string const& data);
+	AssDialogue(std::string_view data);
 	~AssDialogue();
 };
 
@@ -86,6 +86,8 @@ void AssFile::swap(AssFile& from) throw() {
 	Extradata.swap(from.Extradata);
 	std::swap(Properties, from.Properties);
 	std::swap(next_extradata_id, from.next_extradata_id);
+	TimeIndex.Invalidate();
+	from.TimeIndex.Invalidate();
 }
 
 AssFile& AssFile::operator=(AssFile from) {
@@ -191,13 +193,22 @@ AssStyle *AssFile::GetStyle(std::string const& name) {
 }
 
 int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *single_line) {
+	PrepareCommit(type);
+
 	if (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM) || (type & COMMIT_ORDER)) {
 		int i = 0;
 		for (auto& event : Events)
 			event.Row = i++;
+		TimeIndex.Invalidate();
+	}
+	else if (type & COMMIT_DIAG_TIME) {
+		if (single_line)
+			TimeIndex.LineChanged(single_line);
+		else
+			TimeIndex.Invalidate();
 	}
 
-	PushState({desc, &amend_id, single_line});
+	PushState({desc, &amend_id, type, single_line});
 
 	AnnounceCommit(type, single_line);
 
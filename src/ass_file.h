@@ -28,6 +28,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include "ass_entry.h"
+#include "ass_time_index.h"
 
 #include <libaegisub/fs.h>
 #include <libaegisub/signal.h>
@@ -57,6 +58,7 @@ struct ExtradataEntry {
 struct AssFileCommit {
 	wxString const& message;
 	int *commit_id;
+	int type;
 	AssDialogue *single_line;
 };
 
@@ -84,6 +86,8 @@ class AssFile {
 	/// A set of changes has been committed to the file (AssFile::COMMITType)
 	agi::signal::Signal<int, const AssDialogue*> AnnounceCommit;
 	agi::signal::Signal<AssFileCommit> PushState;
+	/// A set of changes is about to be committed (AssFile::COMMITType)
+	agi::signal::Signal<int> PrepareCommit;
 public:
 	/// The lines in the file
 	std::vector<AssInfo> Info;
@@ -95,6 +99,9 @@ public:
 
 	uint32_t next_extradata_id = 0;
 
+	/// Index of Events by time, which is kept up to date by Commit()
+	AssTimeIndex TimeIndex{*this};
+
 	AssFile();
 	AssFile(const AssFile &from);
 	AssFile& operator=(AssFile from);
@@ -182,6 +189,9 @@ public:
 
 	DEFINE_SIGNAL_ADDERS(AnnounceCommit, AddCommitListener)
 	DEFINE_SIGNAL_ADDERS(PushState, AddUndoManager)
+	/// Listeners which have changed the file without committing can commit
+	/// from here, so that their changes come before this commit's
+	DEFINE_SIGNAL_ADDERS(PrepareCommit, AddPrepareCommitListener)
 
 	/// @brief Flag the file as modified and push a copy onto the undo stack
 	/// @param desc        Undo description
@@ -0,0 +1,128 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project https://aegisub.org/
+
+/// @file ass_file_snapshot.cpp
+/// @brief Immutable shared copies of subtitle files
+/// @ingroup subs_storage
+///
+
+#include "ass_file_snapshot.h"
+
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_info.h"
+#include "ass_style.h"
+
+#include <algorithm>
+
+AssFileSnapshot::AssFileSnapshot()
+: script_info(std::make_shared<ScriptInfo>())
+, styles(std::make_shared<std::vector<AssStyle>>())
+, events(std::make_shared<EventChunks>())
+, attachments(std::make_shared<std::vector<AssAttachment>>())
+, extradata(std::make_shared<std::vector<ExtradataEntry>>())
+{
+}
+
+AssFileSnapshot::AssFileSnapshot(AssFile const& file)
+: attachments(std::make_shared<std::vector<AssAttachment>>(file.Attachments))
+, extradata(std::make_shared<std::vector<ExtradataEntry>>(file.Extradata))
+{
+	auto info = std::make_shared<ScriptInfo>();
+	info->reserve(file.Info.size());
+	for (auto const& line : file.Info)
+		info->emplace_back(line.Key(), line.Value());
+	script_info = std::move(info);
+
+	styles = std::make_shared<std::vector<AssStyle>>(file.Styles.begin(), file.Styles.end());
+
+	SetEvents(std::vector<AssDialogueBase>(file.Events.begin(), file.Events.end()));
+}
+
+void AssFileSnapshot::SetScriptInfo(ScriptInfo const& info) {
+	script_info = std::make_shared<ScriptInfo>(info);
+}
+
+void AssFileSnapshot::SetStyles(std::vector<AssStyle> const& new_styles) {
+	styles = std::make_shared<std::vector<AssStyle>>(new_styles);
+}
+
+void AssFileSnapshot::SetAttachments(std::vector<AssAttachment> const& new_attachments) {
+	attachments = std::make_shared<std::vector<AssAttachment>>(new_attachments);
+}
+
+void AssFileSnapshot::SetExtradata(std::vector<ExtradataEntry> const& new_extradata) {
+	extradata = std::make_shared<std::vector<ExtradataEntry>>(new_extradata);
+}
+
+void AssFileSnapshot::SetEvents(std::vector<AssDialogueBase> const& new_events) {
+	auto chunks = std::make_shared<EventChunks>();
+	chunks->reserve((new_events.size() + chunk_size - 1) / chunk_size);
+	for (size_t i = 0; i < new_events.size(); i += chunk_size) {
+		auto end = std::min(i + chunk_size, new_events.size());
+		chunks->push_back(std::make_shared<EventChunk>(new_events.begin() + i, new_events.begin() + end));
+	}
+	events = std::move(chunks);
+	event_count = new_events.size();
+}
+
+void AssFileSnapshot::SetEvents(std::vector<AssDialogueBase> const& new_events, std::vector<size_t> const& changed) {
+	if (new_events.size() != event_count)
+		return SetEvents(new_events);
+	if (changed.empty())
+		return;
+
+	auto chunks = std::make_shared<EventChunks>(*events);
+	std::vector<bool> copied(chunks->size());
+	for (size_t index : changed) {
+		size_t chunk = index / chunk_size;
+		if (copied[chunk]) continue;
+		copied[chunk] = true;
+
+		size_t begin = chunk * chunk_size;
+		size_t end = std::min(begin + chunk_size, new_events.size());
+		(*chunks)[chunk] = std::make_shared<EventChunk>(new_events.begin() + begin, new_events.begin() + end);
+	}
+	events = std::move(chunks);
+}
+
+void AssFileSnapshot::CopyTo(AssFile &dst) const {
+	dst.Info.clear();
+	dst.Info.reserve(script_info->size());
+	for (auto const& info : *script_info)
+		dst.Info.emplace_back(info.first, info.second);
+
+	dst.Styles.clear_and_dispose([](AssStyle *e) { delete e; });
+	for (auto const& style : *styles)
+		dst.Styles.push_back(*new AssStyle(style));
+
+	dst.Events.clear_and_dispose([](AssDialogue *e) { delete e; });
+	int row = 0;
+	for (auto const& chunk : *events) {
+		for (auto const& line : *chunk) {
+			auto copy = new AssDialogue(line);
+			copy->Row = row++;
+			dst.Events.push_back(*copy);
+		}
+	}
+
+	dst.Attachments = *attachments;
+	dst.Extradata = *extradata;
+	dst.next_extradata_id = 0;
+	for (auto const& entry : dst.Extradata)
+		dst.next_extradata_id = std::max(dst.next_extradata_id, entry.id + 1);
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project https://aegisub.org/
+
+/// @file ass_file_snapshot.h
+/// @see ass_file_snapshot.cpp
+/// @ingroup subs_storage
+///
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class AssAttachment;
+class AssFile;
+class AssStyle;
+struct AssDialogueBase;
+struct ExtradataEntry;
+
+/// @class AssFileSnapshot
+/// @brief An immutable copy of the contents of an AssFile
+///
+/// Copying a snapshot is O(1), as all of its contents are held in
+/// reference-counted immutable nodes. Modifying a snapshot replaces only the
+/// nodes which contain the modified entries, so a new snapshot made after a
+/// commit shares everything the commit didn't touch with the previous one.
+///
+/// This is intended for handing the file off to things running in the
+/// background, which can then make an AssFile out of it on their own thread.
+class AssFileSnapshot {
+public:
+	using ScriptInfo = std::vector<std::pair<std::string, std::string>>;
+	using EventChunk = std::vector<AssDialogueBase>;
+	using EventChunks = std::vector<std::shared_ptr<const EventChunk>>;
+
+	/// Number of lines stored in each node
+	static constexpr size_t chunk_size = 256;
+
+private:
+	std::shared_ptr<const ScriptInfo> script_info;
+	std::shared_ptr<const std::vector<AssStyle>> styles;
+	std::shared_ptr<const EventChunks> events;
+	std::shared_ptr<const std::vector<AssAttachment>> attachments;
+	std::shared_ptr<const std::vector<ExtradataEntry>> extradata;
+	size_t event_count = 0;
+
+public:
+	/// Create an empty snapshot
+	AssFileSnapshot();
+	/// Create a snapshot of the current contents of a file
+	explicit AssFileSnapshot(AssFile const& file);
+
+	void SetScriptInfo(ScriptInfo const& info);
+	void SetStyles(std::vector<AssStyle> const& new_styles);
+	void SetAttachments(std::vector<AssAttachment> const& new_attachments);
+	void SetExtradata(std::vector<ExtradataEntry> const& new_extradata);
+	/// Replace all of the lines
+	void SetEvents(std::vector<AssDialogueBase> const& new_events);
+	/// Update the modified lines from a list with the same number of lines,
+	/// copying only the nodes which contain them
+	/// @param new_events Full new list of lines
+	/// @param changed Indices of the lines which have changed
+	void SetEvents(std::vector<AssDialogueBase> const& new_events, std::vector<size_t> const& changed);
+
+	size_t GetEventCount() const { return event_count; }
+
+	ScriptInfo const& GetScriptInfo() const { return *script_info; }
+	std::vector<AssStyle> const& GetStyles() const { return *styles; }
+	std::vector<AssAttachment> const& GetAttachments() const { return *attachments; }
+	std::vector<ExtradataEntry> const& GetExtradata() const { return *extradata; }
+	/// Get the nodes the lines are stored in. A node which is shared by two
+	/// snapshots has the same contents in both.
+	EventChunks const& GetEventChunks() const { return *events; }
+
+	/// Replace the contents of a file with a copy of this snapshot
+	///
+	/// Project properties are not part of the snapshot and are left unchanged.
+	void CopyTo(AssFile &dst) const;
+};
@@ -41,6 +41,7 @@
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <functional>
+#include <mutex>
 
 using namespace boost::adaptors;
 
@@ -172,9 +173,10 @@ struct AssOverrideTagProto {
 };
 
 static std::vector<AssOverrideTagProto> proto;
+/// Indices into proto of the tags whose names start with each character after
+/// the slash, in the same order as in proto
+static std::array<std::vector<unsigned char>, 128> proto_index;
 static void load_protos() {
-	if (!proto.empty()) return;
-
 	proto.resize(56);
 	int i = 0;
 
@@ -305,20 +307,36 @@ static void load_protos() {
 	proto[i].AddParam(VariableDataType::INT, AssParameterClass::RELATIVE_TIME_START,OPTIONAL_3 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::FLOAT, AssParameterClass::NORMAL,OPTIONAL_2 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::BLOCK);
+
+	for (size_t j = 0; j < proto.size(); ++j)
+		proto_index[static_cast<unsigned char>(proto[j].name[1])].push_back(static_cast<unsigned char>(j));
+}
+
+/// Find the first prototype whose name the text of a tag starts with
+AssOverrideTagProto::iterator find_proto(std::string_view text) {
+	static std::once_flag loaded;
+	std::call_once(loaded, load_protos);
+
+	if (text.size() < 2 || text[0] != '\\' || static_cast<unsigned char>(text[1]) >= proto_index.size())
+		return proto.end();
+	for (auto i : proto_index[static_cast<unsigned char>(text[1])]) {
+		if (text.starts_with(proto[i].name))
+			return proto.begin() + i;
+	}
+	return proto.end();
 }
 
-std::vector<std::string> tokenize(std::string_view text) {
-	std::vector<std::string> paramList;
-	paramList.reserve(6);
+void tokenize(std::string_view text, std::vector<std::string_view> &paramList) {
+	paramList.clear();
 
 	if (text.empty())
-		return paramList;
+		return;
 
 	if (text[0] != '(') {
 		// There's just one parameter (because there's no parentheses)
 		// This means text is all our parameters
-		paramList.emplace_back(agi::Trim(text));
-		return paramList;
+		paramList.push_back(agi::Trim(text));
+		return;
 	}
 
 	// Ok, so there are parentheses used here, so there may be more than one parameter
@@ -344,43 +362,55 @@ std::vector<std::string> tokenize(std::string_view text) {
 			i++;
 		}
 		// i now points to the first character not member of this parameter
-		paramList.emplace_back(agi::Trim(text.substr(start, i - start)));
+		paramList.push_back(agi::Trim(text.substr(start, i - start)));
 	}
 
 	if (i+1 < textlen) {
 		// There's some additional garbage after the parentheses
 		// Just add it in for completeness
-		paramList.emplace_back(text.begin() + i + 1, text.end());
+		paramList.push_back(text.substr(i + 1));
 	}
-	return paramList;
 }
 
-void parse_parameters(AssOverrideTag *tag, std::string_view text, AssOverrideTagProto::iterator proto_it) {
-	tag->Clear();
-
-	// Tokenize text, attempting to find all parameters
-	std::vector<std::string> paramList = tokenize(text);
+/// Match the parameters of a tag to its prototype, calling add with the
+/// prototype of each parameter and a pointer to its text, which is null if
+/// the parameter was omitted
+template<typename Func>
+void match_parameters(std::string_view name, std::vector<std::string_view> const& paramList, AssOverrideTagProto::iterator proto_it, Func&& add) {
 	size_t totalPars = paramList.size();
 
-	int parsFlag = 1 << (totalPars - 1); // Get optional parameters flag
+	// Get optional parameters flag. No prototype has more than eight
+	// parameters, so none are present if there are more than that.
+	int parsFlag = totalPars > 0 && totalPars <= 8 ? 1 << (totalPars - 1) : 0;
 	// vector (i)clip is the second clip proto_ittype in the list
-	if ((tag->Name == "\\clip" || tag->Name == "\\iclip") && totalPars != 4) {
+	if ((name == "\\clip" || name == "\\iclip") && totalPars != 4) {
 		++proto_it;
 	}
 
 	unsigned curPar = 0;
 	for (auto& curproto : proto_it->params) {
-		// Create parameter
-		tag->Params.emplace_back(curproto.type, curproto.classification);
-
 		// Check if it's optional and not present
 		if (!(curproto.optional & parsFlag) || curPar >= totalPars)
-			continue;
-
-		tag->Params.back().Set(paramList[curPar++]);
+			add(curproto, nullptr);
+		else
+			add(curproto, &paramList[curPar++]);
 	}
 }
 
+void parse_parameters(AssOverrideTag *tag, std::string_view text, AssOverrideTagProto::iterator proto_it) {
+	tag->Clear();
+
+	// Tokenize text, attempting to find all parameters
+	std::vector<std::string_view> paramList;
+	tokenize(text, paramList);
+
+	match_parameters(tag->Name, paramList, proto_it, [&](AssOverrideParamProto const& curproto, const std::string_view *value) {
+		tag->Params.emplace_back(curproto.type, curproto.classification);
+		if (value)
+			tag->Params.back().Set(std::string(*value));
+	});
+}
+
 }
 
 // From ass_dialogue.h
@@ -430,6 +460,171 @@ void AssDialogueBlockOverride::ProcessParameters(ProcessParametersCallback callb
 	}
 }
 
+template<> std::string_view AssTagTree::Parameter::Get<std::string_view>() const {
+	if (omitted) throw agi::InternalError("AssTagTree::Parameter::Get() called on omitted parameter");
+	return value;
+}
+
+template<> std::string AssTagTree::Parameter::Get<std::string>() const {
+	return std::string(Get<std::string_view>());
+}
+
+template<> int AssTagTree::Parameter::Get<int>() const {
+	auto str = Get<std::string>();
+	if (classification == AssParameterClass::ALPHA)
+		return mid<int>(0, strtol(std::find_if(str.c_str(), str.c_str() + str.size(), isxdigit), nullptr, 16), 255);
+	return atoi(str.c_str());
+}
+
+template<> double AssTagTree::Parameter::Get<double>() const {
+	return atof(Get<std::string>().c_str());
+}
+
+template<> float AssTagTree::Parameter::Get<float>() const {
+	return atof(Get<std::string>().c_str());
+}
+
+template<> bool AssTagTree::Parameter::Get<bool>() const {
+	return Get<int>() != 0;
+}
+
+template<> agi::Color AssTagTree::Parameter::Get<agi::Color>() const {
+	return Get<std::string_view>();
+}
+
+void AssTagTree::ParseBlock(std::string_view text, uint32_t &first_tag, uint32_t &tag_count) {
+	first_tag = static_cast<uint32_t>(tags.size());
+
+	auto add_tag = [&](std::string_view tag_text) {
+		Tag tag{tag_text, false, static_cast<uint32_t>(params.size()), 0};
+		auto cur = find_proto(tag_text);
+		if (cur != proto.end()) {
+			tag.name = tag_text.substr(0, cur->name.size());
+			tag.valid = true;
+			tokenize(tag_text.substr(cur->name.size()), tokens);
+			match_parameters(tag.name, tokens, cur, [&](AssOverrideParamProto const& curproto, const std::string_view *value) {
+				params.push_back(Parameter{value ? *value : std::string_view(), curproto.type, curproto.classification, !value});
+			});
+			tag.param_count = static_cast<uint32_t>(params.size() - tag.first_param);
+		}
+		tags.push_back(tag);
+	};
+
+	// Same splitting as AssDialogueBlockOverride::ParseTags()
+	int depth = 0;
+	size_t start = 0;
+	for (size_t i = 1; i < text.size(); ++i) {
+		if (depth > 0) {
+			if (text[i] == ')')
+				--depth;
+		}
+		else if (text[i] == '\\') {
+			add_tag(text.substr(start, i - start));
+			start = i;
+		}
+		else if (text[i] == '(')
+			++depth;
+	}
+
+	if (!text.empty())
+		add_tag(text.substr(start));
+
+	tag_count = static_cast<uint32_t>(tags.size() - first_tag);
+}
+
+void AssTagTree::Parse(std::string_view text) {
+	blocks.clear();
+	tags.clear();
+	params.clear();
+
+	// Empty line, make an empty block
+	if (text.empty()) {
+		blocks.push_back(Block{AssBlockType::PLAIN, text, 0, 0, 0});
+		return;
+	}
+
+	int drawingLevel = 0;
+	for (size_t len = text.size(), cur = 0; cur < len; ) {
+		// Overrides block
+		if (text[cur] == '{') {
+			size_t end = text.find('}', cur);
+
+			// VSFilter requires that override blocks be closed, while libass
+			// does not. We match VSFilter here.
+			if (end != std::string_view::npos) {
+				auto work = text.substr(cur + 1, end - cur - 1);
+				if (work.size() && work.find('\\') == std::string_view::npos)
+					blocks.push_back(Block{AssBlockType::COMMENT, text.substr(cur, end - cur + 1), 0, 0, 0});
+				else {
+					Block block{AssBlockType::OVERRIDE, work, 0, 0, 0};
+					ParseBlock(work, block.first_tag, block.tag_count);
+					for (auto const& tag : Tags(block)) {
+						if (tag.name == "\\p")
+							drawingLevel = params[tag.first_param].Get<int>(0);
+					}
+					blocks.push_back(block);
+				}
+
+				cur = end + 1;
+				continue;
+			}
+		}
+
+		// Plain-text/drawing block
+		size_t end = std::min(text.find('{', cur + 1), len);
+		auto work = text.substr(cur, end - cur);
+		cur = end;
+
+		if (drawingLevel == 0)
+			blocks.push_back(Block{AssBlockType::PLAIN, work, 0, 0, 0});
+		else
+			blocks.push_back(Block{AssBlockType::DRAWING, work, drawingLevel, 0, 0});
+	}
+
+	// Parse the contents of \t blocks. This appends to params, so it has to
+	// go by index, and picks up blocks nested inside the ones it parses.
+	for (size_t i = 0; i < params.size(); ++i) {
+		if (params[i].type == VariableDataType::BLOCK && !params[i].omitted) {
+			uint32_t first_tag, tag_count;
+			ParseBlock(params[i].value, first_tag, tag_count);
+			params[i].first_tag = first_tag;
+			params[i].tag_count = tag_count;
+		}
+	}
+}
+
+void AssTagTree::AppendTags(std::string &out, uint32_t first_tag, uint32_t tag_count) const {
+	for (auto const& tag : std::span(tags).subspan(first_tag, tag_count)) {
+		out += tag.name;
+
+		// Same as AssOverrideTag::operator std::string()
+		bool parentheses = tag.param_count > 1;
+		if (parentheses) out += '(';
+		bool first = true;
+		for (auto const& param : Params(tag)) {
+			if (param.omitted) continue;
+			if (!first) out += ',';
+			out += param.value;
+			first = false;
+		}
+		if (parentheses) out += ')';
+	}
+}
+
+std::string AssTagTree::GetText() const {
+	std::string out;
+	for (auto const& block : blocks) {
+		if (block.type == AssBlockType::OVERRIDE) {
+			out += '{';
+			AppendTags(out, block.first_tag, block.tag_count);
+			out += '}';
+		}
+		else
+			out += block.text;
+	}
+	return out;
+}
+
 AssOverrideTag::AssOverrideTag(std::string const& text) {
 	SetText(text);
 }
@@ -441,14 +636,12 @@ void AssOverrideTag::Clear() {
 }
 
 void AssOverrideTag::SetText(const std::string &text) {
-	load_protos();
-	for (auto cur = proto.begin(); cur != proto.end(); ++cur) {
-		if (text.starts_with(cur->name)) {
-			Name = cur->name;
-			parse_parameters(this, text.substr(Name.size()), cur);
-			valid = true;
-			return;
-		}
+	auto cur = find_proto(text);
+	if (cur != proto.end()) {
+		Name = cur->name;
+		parse_parameters(this, std::string_view(text).substr(Name.size()), cur);
+		valid = true;
+		return;
 	}
 
 	// Junk tag
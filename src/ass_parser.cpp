@@ -23,6 +23,8 @@
 
 #include <libaegisub/ass/string_codec.h>
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/split.h>
 #include <libaegisub/util.h>
 
 #include <algorithm>
@@ -103,7 +105,13 @@ AssParser::AssParser(AssFile *target, int version)
 
 AssParser::~AssParser() = default;
 
-void AssParser::ParseAttachmentLine(std::string const& data) {
+void AssParser::FinishAttachment() {
+	target->Attachments.emplace_back(attach_header, attach_data, attach_group);
+	attach_header.clear();
+	attach_data.clear();
+}
+
+void AssParser::ParseAttachmentLine(std::string_view data) {
 	bool is_filename = data.starts_with("fontname: ") || data.starts_with("filename: ");
 
 	bool valid_data = data.size() > 0 && data.size() <= 80;
@@ -116,19 +124,20 @@ void AssParser::ParseAttachmentLine(std::string const& data) {
 
 	// Data is over, add attachment to the file
 	if (!valid_data || is_filename) {
-		target->Attachments.push_back(*attach.release());
+		FinishAttachment();
 		AddLine(data);
 	}
 	else {
-		attach->AddData(data);
+		attach_data.append(data);
+		attach_data += "\r\n";
 
 		// Done building
 		if (data.size() < 80)
-			target->Attachments.push_back(*attach.release());
+			FinishAttachment();
 	}
 }
 
-void AssParser::ParseScriptInfoLine(std::string const& data) {
+void AssParser::ParseScriptInfoLine(std::string_view data) {
 	if (data.starts_with(";")) {
 		// Skip stupid comments added by other programs
 		// Of course, we'll add our own in place later... ;)
@@ -136,8 +145,7 @@ void AssParser::ParseScriptInfoLine(std::string const& data) {
 	}
 
 	if (data.starts_with("ScriptType:")) {
-		std::string version_str = data.substr(11);
-		boost::trim(version_str);
+		std::string version_str(agi::Trim(data.substr(11)));
 		boost::to_lower(version_str);
 		if (version_str == "v4.00")
 			version = 0;
@@ -155,15 +163,15 @@ void AssParser::ParseScriptInfoLine(std::string const& data) {
 	size_t pos = data.find(':');
 	if (pos == data.npos) return;
 
-	auto key = data.substr(0, pos);
-	auto value = data.substr(pos + 1);
+	std::string key(data.substr(0, pos));
+	std::string value(data.substr(pos + 1));
 	boost::trim_left(value);
 
 	if (!property_handler->ProcessProperty(target, key, value))
-		target->Info.push_back(*new AssInfo(std::move(key), std::move(value)));
+		target->Info.emplace_back(std::move(key), std::move(value));
 }
 
-void AssParser::ParseMetadataLine(std::string const& rawdata) {
+void AssParser::ParseMetadataLine(std::string_view rawdata) {
 	std::string data = SanitizeLine(rawdata);
 
 	size_t pos = data.find(':');
@@ -176,27 +184,45 @@ void AssParser::ParseMetadataLine(std::string const& rawdata) {
 	property_handler->ProcessProperty(target, key, value);
 }
 
-void AssParser::ParseEventLine(std::string const& data) {
-	if (data.starts_with("Dialogue:") || data.starts_with("Comment:"))
-		target->Events.push_back(*new AssDialogue(data));
+void AssParser::ParseEventLine(std::string_view data) {
+	if (data.starts_with("Dialogue:") || data.starts_with("Comment:")) {
+		if (defer_events)
+			pending_events.push_back(data);
+		else
+			target->Events.push_back(*new AssDialogue(data));
+	}
+}
+
+void AssParser::ParsePendingEvents() {
+	std::vector<std::unique_ptr<AssDialogue>> events(pending_events.size());
+	agi::dispatch::ParallelFor(events.size(), [&](size_t i) {
+		events[i] = std::make_unique<AssDialogue>(pending_events[i]);
+	});
+	for (auto& line : events)
+		target->Events.push_back(*line.release());
+	pending_events.clear();
 }
 
-void AssParser::ParseStyleLine(std::string const& data) {
+void AssParser::ParseStyleLine(std::string_view data) {
 	if (data.starts_with("Style:"))
-		target->Styles.push_back(*new AssStyle(data, version));
+		target->Styles.push_back(*new AssStyle(std::string(data), version));
 }
 
-void AssParser::ParseFontLine(std::string const& data) {
-	if (data.starts_with("fontname: "))
-		attach = std::make_unique<AssAttachment>(data, AssEntryGroup::FONT);
+void AssParser::ParseFontLine(std::string_view data) {
+	if (data.starts_with("fontname: ")) {
+		attach_header = data;
+		attach_group = AssEntryGroup::FONT;
+	}
 }
 
-void AssParser::ParseGraphicsLine(std::string const& data) {
-	if (data.starts_with("filename: "))
-		attach = std::make_unique<AssAttachment>(data, AssEntryGroup::GRAPHIC);
+void AssParser::ParseGraphicsLine(std::string_view data) {
+	if (data.starts_with("filename: ")) {
+		attach_header = data;
+		attach_group = AssEntryGroup::GRAPHIC;
+	}
 }
 
-void AssParser::ParseExtradataLine(std::string const &rawdata) {
+void AssParser::ParseExtradataLine(std::string_view rawdata) {
 	std::string data = SanitizeLine(rawdata);
 
 	static const boost::regex matcher("Data:[[:space:]]*(\\d+),([^,]+),(.)(.*)");
@@ -225,17 +251,17 @@ void AssParser::ParseExtradataLine(std::string const &rawdata) {
 	}
 }
 
-std::string AssParser::SanitizeLine(std::string const& data) {
-	std::string result = data;
+std::string AssParser::SanitizeLine(std::string_view data) {
+	std::string result(data);
 	boost::replace_all(result, std::string("\0", 1), "\uFFFD");		// Unicode replacement character
 	return result;
 }
 
-void AssParser::AddLine(std::string const& data) {
+void AssParser::AddLine(std::string_view data) {
 	// Special-case for attachments since a line could theoretically be both a
 	// valid attachment data line and a valid section header, and if an
 	// attachment is in progress it needs to be treated as that
-	if (attach.get()) {
+	if (!attach_header.empty()) {
 		ParseAttachmentLine(data);
 		return;
 	}
@@ -245,7 +271,7 @@ void AssParser::AddLine(std::string const& data) {
 	// Section header
 	if (data[0] == '[' && data.back() == ']') {
 		// Ugly hacks to allow intermixed v4 and v4+ style sections
-		const std::string low = boost::to_lower_copy(data);
+		const std::string low = boost::to_lower_copy(std::string(data));
 		if (low == "[v4 styles]") {
 			version = 0;
 			state = &AssParser::ParseStyleLine;
@@ -273,3 +299,24 @@ void AssParser::AddLine(std::string const& data) {
 
 	(this->*state)(data);
 }
+
+void AssParser::AddFile(std::string_view data) {
+	defer_events = true;
+
+	// Split the same way agi::line_iterator does, which means that a trailing
+	// newline results in a final empty line
+	size_t pos = 0;
+	for (;;) {
+		size_t end = data.find('\n', pos);
+		auto line = agi::Trim(data.substr(pos, end == data.npos ? data.npos : end - pos));
+		if (line.starts_with("\xEF\xBB\xBF"))
+			line.remove_prefix(3);
+		AddLine(line);
+
+		if (end == data.npos) break;
+		pos = end + 1;
+	}
+
+	defer_events = false;
+	ParsePendingEvents();
+}
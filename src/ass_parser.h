@@ -14,9 +14,11 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
-class AssAttachment;
 class AssFile;
+enum class AssEntryGroup;
 
 class AssParser {
 	class HeaderToProperty;
@@ -24,23 +26,43 @@ class AssParser {
 
 	AssFile *target;
 	int version;
-	std::unique_ptr<AssAttachment> attach;
-	void (AssParser::*state)(std::string const&);
-
-	void ParseAttachmentLine(std::string const& data);
-	void ParseEventLine(std::string const& data);
-	void ParseStyleLine(std::string const& data);
-	void ParseScriptInfoLine(std::string const& data);
-	void ParseMetadataLine(std::string const& data);
-	void ParseFontLine(std::string const& data);
-	void ParseGraphicsLine(std::string const& data);
-	void ParseExtradataLine(std::string const &data);
-	void UnknownLine(std::string const&) { }
-
-	std::string SanitizeLine(std::string const& data);
+	void (AssParser::*state)(std::string_view);
+
+	/// Header line of the attachment being read, or empty if there isn't one
+	std::string attach_header;
+	/// Encoded data of the attachment being read
+	std::string attach_data;
+	AssEntryGroup attach_group;
+
+	/// Should event lines be queued in pending_events rather than parsed
+	/// immediately?
+	bool defer_events = false;
+	std::vector<std::string_view> pending_events;
+
+	void ParseAttachmentLine(std::string_view data);
+	void ParseEventLine(std::string_view data);
+	void ParseStyleLine(std::string_view data);
+	void ParseScriptInfoLine(std::string_view data);
+	void ParseMetadataLine(std::string_view data);
+	void ParseFontLine(std::string_view data);
+	void ParseGraphicsLine(std::string_view data);
+	void ParseExtradataLine(std::string_view data);
+	void UnknownLine(std::string_view) { }
+
+	void FinishAttachment();
+	void ParsePendingEvents();
+
+	std::string SanitizeLine(std::string_view data);
 public:
 	AssParser(AssFile *target, int version);
 	~AssParser();
 
-	void AddLine(std::string const& data);
+	void AddLine(std::string_view data);
+
+	/// @brief Parse the entire contents of a UTF-8 file
+	///
+	/// Lines are trimmed the same way TextFileReader trims them, so this
+	/// gives the same result as passing each line of the file to AddLine, but
+	/// without copying each line and with the events parsed in parallel.
+	void AddFile(std::string_view data);
 };
@@ -0,0 +1,166 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project https://aegisub.org/
+
+/// @file ass_time_index.cpp
+/// @brief Lookup of dialogue lines by time
+/// @ingroup subs_storage
+///
+
+#include "ass_time_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+template<typename Entry>
+bool by_start(Entry const& a, Entry const& b) {
+	return a.start < b.start || (a.start == b.start && a.order < b.order);
+}
+}
+
+void AssTimeIndex::Invalidate() {
+	valid = false;
+}
+
+void AssTimeIndex::Build() const {
+	entries.clear();
+	indexed_start.clear();
+
+	size_t order = 0;
+	for (auto& line : file.Events) {
+		entries.push_back({(int)line.Start, (int)line.End, order++, &line});
+		indexed_start[&line] = line.Start;
+	}
+	std::sort(entries.begin(), entries.end(), by_start<Entry>);
+
+	leaves = 1;
+	while (leaves < entries.size())
+		leaves *= 2;
+	max_end.assign(2 * leaves, INT_MIN);
+	if (!entries.empty())
+		Refresh(0, entries.size() - 1);
+
+	valid = true;
+}
+
+void AssTimeIndex::Refresh(size_t first, size_t last) const {
+	for (size_t i = first; i <= last; ++i)
+		max_end[leaves + i] = entries[i].end;
+
+	for (first += leaves, last += leaves; first > 1; ) {
+		first /= 2;
+		last /= 2;
+		for (size_t i = first; i <= last; ++i)
+			max_end[i] = std::max(max_end[2 * i], max_end[2 * i + 1]);
+	}
+}
+
+size_t AssTimeIndex::Find(const AssDialogue *line) const {
+	auto it = indexed_start.find(line);
+	if (it == indexed_start.end()) return entries.size();
+
+	auto pos = std::lower_bound(entries.begin(), entries.end(), it->second,
+		[](Entry const& e, int start) { return e.start < start; });
+	for (; pos != entries.end() && pos->start == it->second; ++pos) {
+		if (pos->line == line)
+			return pos - entries.begin();
+	}
+	return entries.size();
+}
+
+void AssTimeIndex::LineChanged(const AssDialogue *line) {
+	if (!valid) return;
+
+	size_t i = Find(line);
+	if (i == entries.size()) {
+		Invalidate();
+		return;
+	}
+
+	Entry entry = entries[i];
+	entry.start = line->Start;
+	entry.end = line->End;
+	indexed_start[line] = entry.start;
+
+	// Shift the entries between the old and new positions over by one
+	auto it = entries.begin() + i;
+	size_t j;
+	if (by_start(entry, *it)) {
+		auto dst = std::lower_bound(entries.begin(), it, entry, by_start<Entry>);
+		std::rotate(dst, it, it + 1);
+		j = dst - entries.begin();
+	}
+	else {
+		auto dst = std::lower_bound(it + 1, entries.end(), entry, by_start<Entry>);
+		std::rotate(it, it + 1, dst);
+		j = dst - entries.begin() - 1;
+	}
+	entries[j] = entry;
+	Refresh(std::min(i, j), std::max(i, j));
+}
+
+void AssTimeIndex::LineReplaced(const AssDialogue *old_line, AssDialogue *new_line) {
+	if (!valid) return;
+
+	size_t i = Find(old_line);
+	if (i == entries.size()) {
+		Invalidate();
+		return;
+	}
+
+	indexed_start.erase(old_line);
+	indexed_start[new_line] = entries[i].start;
+	entries[i].line = new_line;
+	LineChanged(new_line);
+}
+
+std::vector<AssDialogue *> AssTimeIndex::Overlapping(int start, int end) const {
+	if (!valid) Build();
+
+	// Only the entries before this one start before the end of the range
+	size_t last = std::lower_bound(entries.begin(), entries.end(), end,
+		[](Entry const& e, int end) { return e.start < end; }) - entries.begin();
+
+	// Walk down the tree, skipping subtrees which all end before the range
+	struct Node { size_t index, first, width; };
+	std::vector<Node> pending{{1, 0, leaves}};
+	std::vector<Entry const*> found;
+	while (!pending.empty()) {
+		Node node = pending.back();
+		pending.pop_back();
+		if (node.first >= last || max_end[node.index] <= start) continue;
+
+		if (node.width == 1) {
+			found.push_back(&entries[node.first]);
+			continue;
+		}
+
+		size_t half = node.width / 2;
+		pending.push_back({node.index * 2 + 1, node.first + half, half});
+		pending.push_back({node.index * 2, node.first, half});
+	}
+
+	std::sort(found.begin(), found.end(), [](Entry const* a, Entry const* b) { return a->order < b->order; });
+
+	std::vector<AssDialogue *> ret;
+	ret.reserve(found.size());
+	for (auto entry : found)
+		ret.push_back(entry->line);
+	return ret;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project https://aegisub.org/
+
+/// @file ass_time_index.h
+/// @see ass_time_index.cpp
+/// @ingroup subs_storage
+///
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+class AssDialogue;
+class AssFile;
+
+/// @class AssTimeIndex
+/// @brief Index of the dialogue lines of a file by the times they cover
+///
+/// Answers which lines overlap a time range in O(log n + k) rather than by
+/// looking at every line. The index is built on the first query after the
+/// set of lines changes, and AssFile::Commit keeps it up to date. A commit
+/// which changes the times of a single line moves just that line's entry,
+/// so that dragging a line's times around doesn't rebuild anything.
+///
+/// Code which modifies a file without committing it must tell the index
+/// about the change itself.
+class AssTimeIndex {
+	struct Entry {
+		int start;
+		int end;
+		/// Position of the line in the file
+		size_t order;
+		AssDialogue *line;
+	};
+
+	AssFile& file;
+	/// All lines, sorted by start time
+	mutable std::vector<Entry> entries;
+	/// Implicit binary tree over entries holding the latest end time of the
+	/// entries under each node, with the leaves at [leaves, 2 * leaves)
+	mutable std::vector<int> max_end;
+	mutable size_t leaves = 0;
+	/// Start time each line is indexed under
+	mutable std::unordered_map<const AssDialogue *, int> indexed_start;
+	mutable bool valid = false;
+
+	void Build() const;
+	/// Recalculate max_end for the entries in [first, last]
+	void Refresh(size_t first, size_t last) const;
+	/// Find the entry for a line, or entries.size() if it isn't indexed
+	size_t Find(const AssDialogue *line) const;
+
+public:
+	AssTimeIndex(AssFile& file) : file(file) { }
+	AssTimeIndex(AssTimeIndex const&) = delete;
+	AssTimeIndex& operator=(AssTimeIndex const&) = delete;
+
+	/// Discard the index, as lines have been added, removed or reordered
+	void Invalidate();
+
+	/// Update the index after the times of one line have changed
+	void LineChanged(const AssDialogue *line);
+
+	/// Update the index after a line has been replaced by another in the
+	/// same position in the file
+	void LineReplaced(const AssDialogue *old_line, AssDialogue *new_line);
+
+	/// @brief Get the lines which overlap [start, end)
+	/// @return The lines, in the order they appear in the file
+	std::vector<AssDialogue *> Overlapping(int start, int end) const;
+
+	/// Get the lines whose time range includes the given time, in file order
+	std::vector<AssDialogue *> At(int time) const { return Overlapping(time, time + 1); }
+};
@@ -20,41 +20,57 @@
 #include "ass_file.h"
 #include "export_fixstyle.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "options.h"
+#include "subtitles_compositor.h"
 #include "video_frame.h"
 #include "video_provider_manager.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/log.h>
 
-#include <boost/gil.hpp>
+#include <algorithm>
+#include <cmath>
 
 enum {
 	NEW_SUBS_FILE = -1,
 	SUBS_FILE_ALREADY_LOADED = -2
 };
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
-	// Find an unused buffer to use or allocate a new one if needed
-	std::shared_ptr<VideoFrame> frame;
-	for (auto& buffer : buffers) {
-		if (buffer.use_count() == 1) {
-			frame = buffer;
-			break;
-		}
-	}
-
-	if (!frame) {
-		frame = std::make_shared<VideoFrame>();
-		buffers.push_back(frame);
-	}
+/// Largest distance between consecutive requests which is treated as reading
+/// sequentially rather than seeking. Playback skips frames when rendering
+/// can't keep up, so this isn't just one.
+static const int max_read_ahead_step = 4;
 
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
+	// This is usually the same frame as is in the frame cache, so it has to
+	// be copied before drawing subtitles on it
+	std::shared_ptr<const VideoFrame> source;
 	try {
-		source_provider->GetFrame(frame_number, *frame);
+		std::lock_guard<std::mutex> lock(source_lock);
+		source = source_provider->GetSharedFrame(frame_number, frame_pool);
 	}
 	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
 
-	if (raw || !subs_provider || !subs) return frame;
+	if (raw || !subs_provider || !subs) return source;
+
+	// Nothing to draw, so skip the copy. Any changes to the file which
+	// haven't been passed to the subtitles provider yet stay pending.
+	auto lines = subs->TimeIndex.At(static_cast<int>(std::floor(time)));
+	bool visible = std::any_of(lines.begin(), lines.end(), [](const AssDialogue *line) {
+		return !line->Comment;
+	});
+	if (!visible) return source;
 
 	try {
+		// Providers which can apply changes in place always have the entire
+		// file loaded, so there's no need for the single frame dance below
+		if (pending_commit) {
+			if (subs_provider->UpdateSubtitles(subs.get(), *pending_commit, pending_line))
+				single_frame = SUBS_FILE_ALREADY_LOADED;
+			pending_commit.reset();
+			pending_line = nullptr;
+		}
+
 		if (single_frame != frame_number && single_frame != SUBS_FILE_ALREADY_LOADED) {
 			// Generally edits and seeks come in groups; if the last thing done
 			// was seek it is more likely that the user will seek again and
@@ -67,7 +83,6 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 				single_frame = SUBS_FILE_ALREADY_LOADED;
 			}
 			else {
-				AssFixStylesFilter::ProcessSubs(subs.get());
 				single_frame = frame_number;
 				subs_provider->LoadSubtitles(subs.get(), time);
 			}
@@ -75,6 +90,8 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 	}
 	catch (agi::Exception const& err) { throw SubtitlesProviderErrorEvent(err.GetMessage()); }
 
+	auto frame = frame_pool.Get();
+	*frame = *source;
 	try {
 		subs_provider->DrawSubtitles(*frame, time / 1000.);
 	}
@@ -95,41 +112,15 @@ VideoFrame AsyncVideoProvider::GetBlankFrame(bool white) {
 
 VideoFrame AsyncVideoProvider::GetSubtitles(double time) {
 	// We are looking for an RGBA image for which blending that image is equivalent
-	// to blending the current frame's subtitles (however the subtitle provider does this,
-	// usually by blending many separate small images with alpha).
-	// To do this, draw the subtitles once on a black frame and once on a white frame
-	// and solve for the color and alpha.
-	VideoFrame frame_black = GetBlankFrame(false);
-	if (!subs) return frame_black;
-	VideoFrame frame_white = GetBlankFrame(true);
+	// to blending the current frame's subtitles. The subtitle provider renders
+	// this directly as premultiplied alpha, which wxImage doesn't understand.
+	VideoFrame frame = GetBlankFrame(false);
+	if (!subs) return frame;
 
 	subs_provider->LoadSubtitles(subs.get());
-	subs_provider->DrawSubtitles(frame_black, time / 1000.);
-	subs_provider->DrawSubtitles(frame_white, time / 1000.);
-
-	using namespace boost::gil;
-	auto blackview = interleaved_view(frame_black.width, frame_black.height, (bgra8_pixel_t*) frame_black.data.data(), frame_black.width * 4);
-	auto whiteview = interleaved_view(frame_white.width, frame_white.height, (bgra8_pixel_t*) frame_white.data.data(), frame_white.width * 4);
-
-	transform_pixels(blackview, whiteview, blackview, [=](const bgra8_pixel_t black, const bgra8_pixel_t white) -> bgra8_pixel_t {
-		int a = 255 - (white[0] - black[0]);
-
-		bgra8_pixel_t ret;
-		if (a == 0) {
-			ret[0] = 0;
-			ret[1] = 0;
-			ret[2] = 0;
-			ret[3] = 0;
-		} else {
-			ret[0] = black[0] / (a / 255.);
-			ret[1] = black[1] / (a / 255.);
-			ret[2] = black[2] / (a / 255.);
-			ret[3] = a;
-		}
-		return ret;
-	});
-
-	return frame_black;
+	subs_provider->DrawOverlay(frame, time / 1000.);
+	UnpremultiplyFrame(frame);
+	return frame;
 }
 
 std::pair<int, int> AsyncVideoProvider::GetDisplayResolution() const {
@@ -159,42 +150,93 @@ static std::unique_ptr<SubtitlesProvider> get_subs_provider(wxEvtHandler *evt_ha
 
 AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, agi::ycbcr::Header colormatrix, wxEvtHandler *parent, agi::BackgroundRunner *br)
 : worker(agi::dispatch::Create())
+, prefetcher(agi::dispatch::Create())
 , subs_provider(get_subs_provider(parent, br))
 , source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
 , parent(parent)
+, read_ahead_frames(OPT_GET("Provider/Video/Read Ahead")->GetInt())
 {
 }
 
 AsyncVideoProvider::~AsyncVideoProvider() {
 	// Block until all currently queued jobs are complete
 	worker->Sync([]{});
+	// Reading ahead is pointless now, so just stop it
+	++version;
+	prefetcher->Sync([]{});
+}
+
+void AsyncVideoProvider::AddPendingCommit(int type, const AssDialogue *line, std::chrono::steady_clock::time_point when) {
+	if (!pending_since)
+		pending_since = when;
+
+	if (!pending_commit) {
+		pending_commit = type;
+		pending_line = line;
+		return;
+	}
+
+	if (type == AssFile::COMMIT_NEW || *pending_commit == AssFile::COMMIT_NEW)
+		pending_commit = AssFile::COMMIT_NEW;
+	else
+		*pending_commit |= type;
+	if (pending_line != line)
+		pending_line = nullptr;
 }
 
-void AsyncVideoProvider::LoadSubtitles(const AssFile *new_subs) throw() {
+void AsyncVideoProvider::LoadSubtitles(AssFileSnapshot new_subs) throw() {
+	UpdateSubtitles(std::move(new_subs), AssFile::COMMIT_NEW);
+}
+
+void AsyncVideoProvider::UpdateSubtitles(AssFileSnapshot new_subs, int type, std::chrono::steady_clock::time_point changed_at) throw() {
 	uint_fast32_t req_version = ++version;
 
-	auto copy = new AssFile(*new_subs);
+	// The snapshot is turned into a file on the worker thread so that the
+	// copy doesn't block the UI
 	worker->Async([=, this]{
+		auto copy = new AssFile;
+		new_subs.CopyTo(*copy);
+		AssFixStylesFilter::ProcessSubs(copy);
 		subs.reset(copy);
+		// Line pointers into the old copy are no longer valid
+		pending_line = nullptr;
+		AddPendingCommit(type, nullptr, changed_at);
 		single_frame = NEW_SUBS_FILE;
 		ProcAsync(req_version, false);
 	});
 }
 
-void AsyncVideoProvider::UpdateSubtitles(const AssDialogue *changed) throw() {
+void AsyncVideoProvider::UpdateSubtitles(const AssDialogue *changed, int type, std::chrono::steady_clock::time_point changed_at) throw() {
+	UpdateSubtitles(std::vector<const AssDialogue *>{changed}, type, changed_at);
+}
+
+void AsyncVideoProvider::UpdateSubtitles(std::vector<const AssDialogue *> const& changed, int type, std::chrono::steady_clock::time_point changed_at) throw() {
+	if (changed.empty()) return;
 	uint_fast32_t req_version = ++version;
 
-	// Copy just the line which were changed, then replace the line at the
-	// same index in the worker's copy of the file with the new entry
-	auto copy = new AssDialogue(*changed);
+	// Copy just the lines which were changed, then replace the lines at the
+	// same indices in the worker's copy of the file with the new entries
+	std::vector<AssDialogue *> copies;
+	copies.reserve(changed.size());
+	for (auto line : changed)
+		copies.push_back(new AssDialogue(*line));
+	std::sort(begin(copies), end(copies), [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; });
+
 	worker->Async([=, this]{
 		int i = 0;
 		auto it = subs->Events.begin();
-		std::advance(it, copy->Row - i);
-		i = copy->Row;
-		subs->Events.insert(it, *copy);
-		delete &*it--;
+		for (auto copy : copies) {
+			std::advance(it, copy->Row - i);
+			i = copy->Row;
+			subs->Events.insert(it, *copy);
+			subs->TimeIndex.LineReplaced(&*it, copy);
+			delete &*it--;
+
+			if (!subs->GetStyle(copy->Style))
+				copy->Style = "Default";
+		}
 
+		AddPendingCommit(type, copies.size() == 1 ? copies.front() : nullptr, changed_at);
 		single_frame = NEW_SUBS_FILE;
 		ProcAsync(req_version, true);
 	});
@@ -203,13 +245,48 @@ void AsyncVideoProvider::UpdateSubtitles(const AssDialogue *changed) throw() {
 void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 	uint_fast32_t req_version = ++version;
 
+	// Playback and stepping through frames request frames in order, and
+	// will probably keep doing so
+	int step = last_requested >= 0 ? new_frame - last_requested : 0;
+	if (std::abs(step) > max_read_ahead_step || read_ahead_frames <= 0)
+		step = 0;
+	last_requested = new_frame;
+
 	worker->Async([=, this]{
 		time = new_time;
 		frame_number = new_frame;
 		ProcAsync(req_version, false);
+
+		// Start reading ahead only once the requested frame is done so that
+		// it doesn't have to wait for the source provider
+		if (step != 0 && req_version == version)
+			prefetcher->Async([=, this]{ ReadAhead(req_version, new_frame, step); });
 	});
 }
 
+void AsyncVideoProvider::ReadAhead(uint_fast32_t req_version, int frame, int step) {
+	const int frame_count = source_provider->GetFrameCount();
+	for (int i = 1; i <= read_ahead_frames; ++i) {
+		// Any newer request, and in particular a seek, makes what's been
+		// guessed here useless. A frame which is already being decoded can't
+		// be stopped, but the demand path only waits for that one.
+		if (req_version != version) return;
+
+		int n = frame + i * step;
+		if (n < 0 || n >= frame_count) return;
+
+		std::lock_guard<std::mutex> lock(source_lock);
+		try {
+			if (!source_provider->PrefetchFrame(n, i, frame_pool)) return;
+		}
+		catch (VideoProviderError const& err) {
+			// Let the demand path report the error if the frame is ever requested
+			LOG_D("video/async") << "Reading ahead failed at frame " << n << ": " << err.GetMessage();
+			return;
+		}
+	}
+}
+
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
 	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
@@ -244,12 +321,15 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	if (req_version < version || frame_number < 0) return;
 
 	std::vector<AssDialogueBase const*> visible_lines;
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && !(line.Start > time || line.End <= time))
-			visible_lines.push_back(&line);
+	for (auto line : subs->TimeIndex.At(static_cast<int>(std::floor(time)))) {
+		if (!line->Comment)
+			visible_lines.push_back(line);
 	}
 
-	if (check_updated && !NeedUpdate(visible_lines)) return;
+	if (check_updated && !NeedUpdate(visible_lines)) {
+		pending_since.reset();
+		return;
+	}
 
 	last_lines.clear();
 	last_lines.reserve(visible_lines.size());
@@ -260,6 +340,16 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	try {
 		auto evt = new FrameReadyEvent(ProcFrame(frame_number, time), time);
 		evt->SetEventType(EVT_FRAME_READY);
+		evt->changed_at = pending_since;
+
+		if (pending_since) {
+			using namespace std::chrono;
+			LOG_D("video/async") << "Edit to frame latency: "
+				<< duration_cast<microseconds>(steady_clock::now() - *pending_since).count()
+				<< "us with " << subs->Events.size() << " lines";
+			pending_since.reset();
+		}
+
 		parent->QueueEvent(evt);
 	}
 	catch (wxEvent const& err) {
@@ -268,14 +358,15 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	}
 }
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
-	std::shared_ptr<VideoFrame> ret;
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
+	std::shared_ptr<const VideoFrame> ret;
 	worker->Sync([&]{ ret = ProcFrame(frame, time, raw); });
 	return ret;
 }
 
 void AsyncVideoProvider::SetColorSpace(agi::ycbcr::Header matrix) {
 	worker->Async([this, matrix]() {
+		std::lock_guard<std::mutex> lock(source_lock);
 		source_provider->SetColorSpace(matrix);
 	});
 }
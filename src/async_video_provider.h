@@ -14,14 +14,20 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include "ass_file_snapshot.h"
 #include "include/aegisub/video_provider.h"
+#include "video_frame.h"
 
 #include <libaegisub/exception.h>
 #include <libaegisub/fs.h>
 
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <vector>
 #include <wx/event.h>
 
 class AssDialogue;
@@ -30,7 +36,6 @@ class SubtitlesProvider;
 class VideoProvider;
 class VideoProviderError;
 struct AssDialogueBase;
-struct VideoFrame;
 namespace agi {
 	class BackgroundRunner;
 	namespace dispatch { class Queue; }
@@ -40,6 +45,10 @@ namespace agi {
 class AsyncVideoProvider {
 	/// Asynchronous work queue
 	std::unique_ptr<agi::dispatch::Queue> worker;
+	/// Queue for decoding frames ahead of them being requested
+	std::unique_ptr<agi::dispatch::Queue> prefetcher;
+	/// Held while using source_provider, which is used from both queues
+	std::mutex source_lock;
 
 	/// Subtitles provider
 	std::unique_ptr<SubtitlesProvider> subs_provider;
@@ -54,6 +63,16 @@ class AsyncVideoProvider {
 	/// Copy of the subtitles file to avoid having to touch the project context
 	std::unique_ptr<AssFile> subs;
 
+	/// AssFile::CommitType flags for the changes to subs which have not yet
+	/// been passed to the subtitles provider
+	std::optional<int> pending_commit;
+	/// Line in subs changed by the pending commits, if they only changed one
+	const AssDialogue *pending_line = nullptr;
+	/// Time at which the oldest change not yet visible in a frame was made
+	std::optional<std::chrono::steady_clock::time_point> pending_since;
+	/// Record changes which need to be passed to the subtitles provider
+	void AddPendingCommit(int type, const AssDialogue *line, std::chrono::steady_clock::time_point when);
+
 	/// If >= 0, the subtitles provider current has just the lines visible on
 	/// that frame loaded. If -1, the entire file is loaded. If -2, the
 	/// currently loaded file is out of date.
@@ -67,34 +86,63 @@ class AsyncVideoProvider {
 	/// lines have actually changed
 	bool NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines);
 
-	std::shared_ptr<VideoFrame> ProcFrame(int frame, double time, bool raw = false);
+	std::shared_ptr<const VideoFrame> ProcFrame(int frame, double time, bool raw = false);
 
 	/// Produce a frame if req_version is still the current version
 	void ProcAsync(uint_fast32_t req_version, bool check_updated);
 
+	/// Maximum number of frames to decode ahead of the requested one
+	const int read_ahead_frames;
+	/// Last frame number passed to RequestFrame
+	int last_requested = -1;
+
+	/// @brief Decode frames following a requested one into the frame cache
+	/// @param req_version Version of the request; stops once that's outdated
+	/// @param frame       Frame which was requested
+	/// @param step        Distance to each next frame, negative for backwards
+	void ReadAhead(uint_fast32_t req_version, int frame, int step);
+
 	/// Monotonic counter used to drop frames when changes arrive faster than
 	/// they can be rendered
 	std::atomic<uint_fast32_t> version{ 0 };
 
-	std::vector<std::shared_ptr<VideoFrame>> buffers;
+	/// Buffers for decoded frames and frames with subtitles drawn on them
+	VideoFramePool frame_pool;
 
 	// Returns a monochromatic frame with the current dimensions
 	VideoFrame GetBlankFrame(bool white);
 
 public:
 	/// @brief Load the passed subtitle file
-	/// @param subs File to load
-	///
-	/// This function blocks until is it is safe for the calling thread to
-	/// modify subs
-	void LoadSubtitles(const AssFile *subs) throw();
+	/// @param subs Snapshot of the file to load
+	void LoadSubtitles(AssFileSnapshot subs) throw();
+
+	/// @brief Update a previously loaded subtitle file
+	/// @param subs       Snapshot of the new version of the file
+	/// @param type       AssFile::CommitType flags describing what has changed
+	/// @param changed_at When the change was made, for measuring latency
+	void UpdateSubtitles(AssFileSnapshot subs, int type,
+		std::chrono::steady_clock::time_point changed_at = std::chrono::steady_clock::now()) throw();
 
 	/// @brief Update a previously loaded subtitle file
-	/// @param changed Line that has changed
+	/// @param changed    Line that has changed
+	/// @param type       AssFile::CommitType flags describing what has changed
+	/// @param changed_at When the change was made, for measuring latency
 	///
 	/// This function only supports changes to a single existing line, and not
 	/// insertions or deletions.
-	void UpdateSubtitles(const AssDialogue *changed) throw();
+	void UpdateSubtitles(const AssDialogue *changed, int type,
+		std::chrono::steady_clock::time_point changed_at = std::chrono::steady_clock::now()) throw();
+
+	/// @brief Update a previously loaded subtitle file
+	/// @param changed    Lines that have changed
+	/// @param type       AssFile::CommitType flags describing what has changed
+	/// @param changed_at When the oldest of the changes was made, for measuring latency
+	///
+	/// As with the single line version, only changes to existing lines are
+	/// supported. All of the lines are replaced in one pass over the file.
+	void UpdateSubtitles(std::vector<const AssDialogue *> const& changed, int type,
+		std::chrono::steady_clock::time_point changed_at = std::chrono::steady_clock::now()) throw();
 
 	/// @brief Queue a request for a frame
 	/// @brief frame Frame number
@@ -108,7 +156,9 @@ public:
 	/// @brief frame Frame number
 	/// @brief time  Exact start time of the frame in seconds
 	/// @brief raw   Get raw frame without subtitles
-	std::shared_ptr<VideoFrame> GetFrame(int frame, double time, bool raw = false);
+	///
+	/// The frame may be shared with the frame cache, so it must not be modified.
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, double time, bool raw = false);
 
 	/// @brief Synchronously get the subtitles with transparent background
 	/// @brief time  Exact start time of the frame in seconds
@@ -147,11 +197,14 @@ public:
 /// Event which signals that a requested frame is ready
 struct FrameReadyEvent final : public wxEvent {
 	/// Frame which is ready
-	std::shared_ptr<VideoFrame> frame;
+	std::shared_ptr<const VideoFrame> frame;
 	/// Time which was used for subtitle rendering
 	double time;
+	/// When the oldest change to the subtitles first visible in this frame
+	/// was made, if there is one
+	std::optional<std::chrono::steady_clock::time_point> changed_at;
 	wxEvent *Clone() const override { return new FrameReadyEvent(*this); };
-	FrameReadyEvent(std::shared_ptr<VideoFrame> frame, double time)
+	FrameReadyEvent(std::shared_ptr<const VideoFrame> frame, double time)
 	: frame(std::move(frame)), time(time) { }
 };
 
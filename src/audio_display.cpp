@@ -31,6 +31,7 @@
 #include "audio_display.h"
 
 #include "audio_controller.h"
+#include "audio_provider_factory.h"
 #include "audio_renderer.h"
 #include "audio_renderer_spectrum.h"
 #include "audio_renderer_waveform.h"
@@ -772,6 +773,10 @@ void AudioDisplay::ReloadRenderingSettings()
 			spectrum_width[spectrum_quality],
 			spectrum_distance[spectrum_quality]);
 
+		audio_spectrum_renderer->SetDiskCache(
+			GetAudioCacheFilename(context->project->AudioName()),
+			(uint64_t)OPT_GET("Audio/Renderer/Cache/Size")->GetInt() << 20);
+
 		// Frequency curve
 		int64_t spectrum_freq_curve = OPT_GET("Audio/Renderer/Spectrum/FreqCurve")->GetInt();
 		spectrum_freq_curve = mid<int64_t>(0, spectrum_freq_curve, 4);
@@ -781,11 +786,19 @@ void AudioDisplay::ReloadRenderingSettings()
 			spectrum_fref_pos [spectrum_freq_curve]
 		);
 
+		// Bitmaps rendered before the spectrum data arrived have placeholders
+		// in them, so redraw everything once it does
+		spectrum_blocks_connection = audio_spectrum_renderer->AddBlocksReadyListener([this] {
+			audio_renderer->Invalidate();
+			Refresh();
+		});
+
 		audio_renderer_provider = std::move(audio_spectrum_renderer);
 	}
 	else
 	{
 		colour_scheme_name = OPT_GET("Colour/Audio Display/Waveform")->GetString();
+		spectrum_blocks_connection.Disconnect();
 		audio_renderer_provider = std::make_unique<AudioWaveformRenderer>(colour_scheme_name);
 	}
 
@@ -1234,7 +1247,8 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 {
 	this->provider = provider;
 
-	if (!audio_renderer_provider)
+	// The spectrum renderer's disk cache is specific to the audio file
+	if (!audio_renderer_provider || OPT_GET("Audio/Spectrum")->GetBool())
 		ReloadRenderingSettings();
 
 	audio_renderer->SetAudioProvider(provider);
@@ -72,6 +72,9 @@ class AudioDisplay: public wxWindow {
 	/// The current audio renderer
 	std::unique_ptr<AudioRendererBitmapProvider> audio_renderer_provider;
 
+	/// Connection to the spectrum renderer's notifications of newly derived data
+	agi::signal::Connection spectrum_blocks_connection;
+
 	/// The controller managing us
 	AudioController *controller = nullptr;
 
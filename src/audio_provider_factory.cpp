@@ -26,6 +26,9 @@
 #include <libaegisub/path.h>
 #include <libaegisub/string.h>
 
+#include <boost/crc.hpp>
+#include <chrono>
+
 using namespace agi;
 
 std::unique_ptr<AudioProvider> CreateAvisynthAudioProvider(fs::path const& filename, BackgroundRunner *);
@@ -111,8 +114,14 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	if (!cache || !needs_cache)
 		return CreateLockAudioProvider(std::move(provider));
 
+	auto peak_cache = GetAudioCacheFilename(filename);
+	if (!peak_cache.empty()) {
+		CleanAudioCache();
+		peak_cache += ".peaks";
+	}
+
 	// Convert to RAM
-	if (cache == 1) return CreateRAMAudioProvider(std::move(provider));
+	if (cache == 1) return CreateRAMAudioProvider(std::move(provider), peak_cache);
 
 	// Convert to HD
 	if (cache == 2) {
@@ -120,8 +129,30 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		if (path == "default")
 			path = "?temp";
 		auto cache_dir = path_helper.MakeAbsolute(path_helper.Decode(path), "?temp");
-		return CreateHDAudioProvider(std::move(provider), cache_dir);
+		return CreateHDAudioProvider(std::move(provider), cache_dir, peak_cache);
 	}
 
 	throw InternalError("Invalid audio caching method");
 }
+
+fs::path GetAudioCacheFilename(fs::path const& filename) {
+	if (!OPT_GET("Audio/Renderer/Cache/Enabled")->GetBool() || !fs::FileExists(filename))
+		return {};
+
+	// Same scheme as the FFMS2 index cache
+	boost::crc_32_type hash;
+	hash.process_bytes(filename.string().c_str(), filename.string().size());
+	auto modified_time = std::chrono::duration_cast<std::chrono::seconds>(fs::ModifiedTime(filename).time_since_epoch()).count();
+
+	auto result = config::path->Decode(agi::Str("?local/audiocache/", std::to_string(hash.checksum()), "_",
+		std::to_string(fs::Size(filename)), "_", std::to_string(modified_time)));
+	fs::CreateDirectory(result.parent_path());
+	return result;
+}
+
+void CleanAudioCache() {
+	CleanCache(config::path->Decode("?local/audiocache/"),
+		"*",
+		OPT_GET("Audio/Renderer/Cache/Size")->GetInt(),
+		OPT_GET("Audio/Renderer/Cache/Files")->GetInt());
+}
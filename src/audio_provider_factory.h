@@ -28,3 +28,15 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(agi::fs::path const& filena
                                                      agi::Path const& path_helper,
                                                      agi::BackgroundRunner *br);
 std::vector<std::string> GetAudioProviderNames();
+
+/// @brief Get the path prefix for the on-disk cache of data derived from an audio file
+/// @param filename Audio file
+/// @return The prefix, or an empty path if the cache is disabled or the file
+///         isn't a real file
+///
+/// Each user of the cache appends its own suffix to the prefix.
+agi::fs::path GetAudioCacheFilename(agi::fs::path const& filename);
+
+/// Delete the least recently used files in the on-disk cache of derived audio
+/// data if it's over the configured size
+void CleanAudioCache();
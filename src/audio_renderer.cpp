@@ -191,7 +191,7 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	// And the offset in it to start its use at
 	const int firstbitmapoffset = start % cache_bitmap_width;
 	// The last bitmap required
-	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetDecodedSamples()) - 1);
+	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(renderer->GetRenderableSamples()) - 1);
 
 	// Set a clipping region so that the first and last bitmaps don't draw
 	// outside the requested range
@@ -222,6 +222,11 @@ void AudioRenderer::Invalidate()
 	needs_age = false;
 }
 
+int64_t AudioRendererBitmapProvider::GetRenderableSamples() const
+{
+	return provider ? provider->GetDecodedSamples() : 0;
+}
+
 void AudioRendererBitmapProvider::SetProvider(agi::AudioProvider *const _provider)
 {
 	if (compare_and_set(provider, _provider))
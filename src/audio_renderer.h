@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -287,4 +288,10 @@ public:
 	/// Deriving classes should override this method if they implement any
 	/// kind of caching.
 	virtual void AgeCache([[maybe_unused]] size_t max_size) { }
+
+	/// @brief Get the number of samples from the start of the audio which can be drawn
+	///
+	/// This is the number of samples decoded so far unless the renderer has
+	/// another source for the data it draws, such as a disk cache.
+	virtual int64_t GetRenderableSamples() const;
 };
@@ -35,36 +35,57 @@
 #include "audio_renderer_spectrum.h"
 
 #include "audio_colorscheme.h"
-#ifndef WITH_FFTW3
+#ifdef WITH_FFTW3
+#include <fftw3.h>
+#else
 #include "fft.h"
 #endif
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/log.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
 
 #include <wx/image.h>
 #include <wx/dcmemory.h>
 
-/// Allocates blocks of derived data for the audio spectrum
+namespace {
+#ifdef WITH_FFTW3
+/// FFTW's planner isn't thread-safe, so all plans are created and destroyed
+/// while holding this
+std::mutex fftw_planner_mutex;
+#endif
+
+/// Number of blocks computed by each background job
+const size_t blocks_per_job = 16;
+
+/// Number of columns past the end of each rendered range to compute in advance
+const int lookahead_columns = 256;
+
+/// Identifies a spectrum disk cache file, and changes whenever the format does
+const char disk_cache_magic[8] = {'A', 'G', 'I', 'S', 'P', 'E', 'C', '1'};
+
+/// Values are stored on disk as 16-bit fixed point in the range [0, disk_cache_max]
+const float disk_cache_max = 2.f;
+}
+
+/// Describes blocks of derived data for the audio spectrum
+///
+/// The blocks are computed in the background by AudioSpectrumJobs and inserted
+/// into the cache when they're ready, so this doesn't produce blocks itself.
 struct AudioSpectrumCacheBlockFactory {
 	typedef std::unique_ptr<float, std::default_delete<float[]>> BlockType;
 
 	/// Pointer back to the owning spectrum renderer
 	AudioSpectrumRenderer *spectrum;
 
-	/// @brief Allocate and fill a data block
-	/// @param i Index of the block to produce data for
-	/// @return Newly allocated and filled block
-	///
-	/// The filling is delegated to the spectrum renderer
-	BlockType ProduceBlock(size_t i)
-	{
-		auto res = new float[((size_t)1)<<spectrum->derivation_size];
-		spectrum->FillBlock(i, res);
-		return BlockType(res);
-	}
-
 	/// @brief Calculate the in-memory size of a spec
 	/// @return The size in bytes of a spectrum cache block
 	size_t GetBlockSize() const
@@ -83,42 +104,156 @@ public:
 	}
 };
 
-AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_name)
-{
-	colors.reserve(AudioStyle_MAX);
-	for (int i = 0; i < AudioStyle_MAX; ++i)
-		colors.emplace_back(12, color_scheme_name, i);
-}
+/// @class AudioSpectrumDiskCache
+/// @brief Spectrum blocks stored in a memory-mapped file so that they survive
+///        reopening the audio
+///
+/// The file has a fixed-size header, then one byte per block saying if it has
+/// been stored, then the blocks themselves. Writes may come from any number of
+/// threads as long as no two write the same block at once.
+class AudioSpectrumDiskCache {
+	struct Header {
+		char magic[sizeof(disk_cache_magic)];
+		uint64_t bins;
+		uint64_t block_count;
+	};
+
+	/// Size of the space reserved for the header
+	static const size_t header_size = 64;
+	static_assert(sizeof(Header) <= header_size, "Header doesn't fit");
+
+	agi::persistent_file_mapping file;
+	size_t bins;
+	size_t block_count;
+	/// Which blocks have been stored, mirroring the flags in the file
+	std::unique_ptr<std::atomic<bool>[]> present;
+	/// Number of entries in present which are set
+	std::atomic<size_t> present_count{0};
+	char *flags;
+	uint16_t *data;
+
+	static uint64_t FileSize(size_t bins, size_t block_count)
+	{
+		// Round the flags up to keep the data aligned
+		return header_size + ((block_count + 7) & ~size_t(7)) + uint64_t(block_count) * bins * sizeof(uint16_t);
+	}
 
-AudioSpectrumRenderer::~AudioSpectrumRenderer()
-{
-	// This sequence will clean up
-	provider = nullptr;
-	RecreateCache();
-}
+public:
+	AudioSpectrumDiskCache(agi::fs::path const& path, size_t bins, size_t block_count)
+	: file(path, FileSize(bins, block_count))
+	, bins(bins)
+	, block_count(block_count)
+	, present(new std::atomic<bool>[block_count])
+	, flags(file.data() + header_size)
+	, data(reinterpret_cast<uint16_t *>(flags + ((block_count + 7) & ~size_t(7))))
+	{
+		Header header{};
+		memcpy(header.magic, disk_cache_magic, sizeof(header.magic));
+		header.bins = bins;
+		header.block_count = block_count;
+
+		// The file name is only derived from the audio file and resolution, so
+		// anything else about it may not match what it was created with
+		if (memcmp(file.data(), &header, sizeof(header)))
+		{
+			memset(file.data(), 0, reinterpret_cast<char *>(data) - file.data());
+			memcpy(file.data(), &header, sizeof(header));
+		}
 
-void AudioSpectrumRenderer::RecreateCache()
-{
-	update_derivation_values ();
+		size_t count = 0;
+		for (size_t i = 0; i < block_count; ++i)
+		{
+			present[i] = flags[i] != 0;
+			count += flags[i] != 0;
+		}
+		present_count = count;
+	}
 
-#ifdef WITH_FFTW3
-	if (dft_plan)
+	/// Size of the file needed for a cache with the given layout
+	static uint64_t RequiredSize(size_t bins, size_t block_count)
 	{
-		fftw_destroy_plan(dft_plan);
-		fftw_free(dft_input);
-		fftw_free(dft_output);
-		dft_plan = nullptr;
-		dft_input = nullptr;
-		dft_output = nullptr;
+		return FileSize(bins, block_count);
+	}
+
+	/// @brief Read a block if it has been stored
+	/// @param      i     Index of the block
+	/// @param[out] block Buffer of bins floats to write the block to
+	/// @return Was the block present?
+	bool Read(size_t i, float *block) const
+	{
+		if (i >= block_count || !present[i].load(std::memory_order_acquire))
+			return false;
+		const uint16_t *src = data + i * bins;
+		for (size_t bin = 0; bin < bins; ++bin)
+			block[bin] = src[bin] * (disk_cache_max / 65535.f);
+		return true;
+	}
+
+	/// @brief Store a block
+	/// @param i     Index of the block
+	/// @param block The bins values to store
+	void Write(size_t i, const float *block)
+	{
+		if (i >= block_count || present[i].load(std::memory_order_relaxed))
+			return;
+		uint16_t *dst = data + i * bins;
+		for (size_t bin = 0; bin < bins; ++bin)
+			dst[bin] = (uint16_t)(mid(0.f, block[bin], disk_cache_max) * (65535.f / disk_cache_max) + 0.5f);
+		flags[i] = 1;
+		if (!present[i].exchange(true, std::memory_order_release))
+			++present_count;
 	}
+
+	/// Have all of the blocks been stored?
+	bool IsComplete() const
+	{
+		return present_count == block_count;
+	}
+};
+
+/// @class AudioSpectrumWorkspace
+/// @brief FFT plan and scratch buffers for computing spectrum blocks
+///
+/// Each background job borrows one of these, so no two threads ever share a
+/// plan or scratch buffers.
+class AudioSpectrumWorkspace {
+	/// Binary logarithm of the number of bins in each block
+	size_t derivation_size;
+
+#ifdef WITH_FFTW3
+	/// FFTW plan data
+	fftw_plan dft_plan = nullptr;
+	/// Pre-allocated input array for FFTW
+	double *dft_input = nullptr;
+	/// Pre-allocated output array for FFTW
+	fftw_complex *dft_output = nullptr;
+#else
+	/// Pre-allocated scratch area for doing FFT derivations
+	std::vector<float> fft_scratch;
 #endif
 
-	if (provider)
+	/// Pre-allocated scratch area for storing raw audio data
+	std::vector<int16_t> audio_scratch;
+
+	/// @brief Convert audio data to float range [-1;+1)
+	/// @param count Samples to convert
+	/// @param dest Buffer to fill
+	template<class T>
+	void ConvertToFloat(size_t count, T *dest)
 	{
-		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
-		cache = std::make_unique<AudioSpectrumCache>(block_count, this);
+		for (size_t si = 0; si < count; ++si)
+		{
+			dest[si] = (T)(audio_scratch[si]) / 32768.0;
+		}
+	}
 
+public:
+	AudioSpectrumWorkspace(size_t derivation_size)
+	: derivation_size(derivation_size)
+	, audio_scratch(2 << derivation_size)
+	{
 #ifdef WITH_FFTW3
+		std::lock_guard<std::mutex> lock(fftw_planner_mutex);
 		dft_input = fftw_alloc_real(2<<derivation_size);
 		dft_output = fftw_alloc_complex(2<<derivation_size);
 		dft_plan = fftw_plan_dft_r2c_1d(
@@ -133,26 +268,329 @@ void AudioSpectrumRenderer::RecreateCache()
 		// 2x for the imaginary part of the output
 		fft_scratch.resize(6 << derivation_size);
 #endif
-		audio_scratch.resize(2 << derivation_size);
 	}
+
+	~AudioSpectrumWorkspace()
+	{
+#ifdef WITH_FFTW3
+		std::lock_guard<std::mutex> lock(fftw_planner_mutex);
+		fftw_destroy_plan(dft_plan);
+		fftw_free(dft_input);
+		fftw_free(dft_output);
+#endif
+	}
+
+	AudioSpectrumWorkspace(AudioSpectrumWorkspace const&) = delete;
+	AudioSpectrumWorkspace& operator=(AudioSpectrumWorkspace const&) = delete;
+
+	/// @brief Fill a block with frequency-power data
+	/// @param      provider     Audio provider to read from
+	/// @param      first_sample First sample of the range to derive the data from
+	/// @param      scale_fix    Compensation for the sampling rate, see AudioSpectrumJobs
+	/// @param[out] block        Address to write the data to
+	void FillBlock(agi::AudioProvider *provider, int64_t first_sample, float scale_fix, float *block)
+	{
+		provider->GetAudio(&audio_scratch[0], first_sample, 2 << derivation_size);
+
+#ifdef WITH_FFTW3
+		ConvertToFloat(2 << derivation_size, dft_input);
+
+		fftw_execute(dft_plan);
+
+		double scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
+
+		fftw_complex *o = dft_output;
+		for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+		{
+			*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
+			o++;
+		}
+#else
+		ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
+
+		float *fft_input = &fft_scratch[0];
+		float *fft_real = &fft_scratch[0] + (2 << derivation_size);
+		float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
+
+		FFT fft;
+		fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
+
+		float scale_factor = scale_fix * 9 / sqrt(2 * (float)(2<<derivation_size));
+
+		for (size_t si = 1<<derivation_size; si > 0; --si)
+		{
+			// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
+			// although the FFT output can apparently get greater magnitudes than 1
+			// despite the input being limited to [-1;+1).
+			*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
+			fft_real++; fft_imag++;
+		}
+#endif
+	}
+};
+
+/// @class AudioSpectrumJobs
+/// @brief Spectrum blocks being computed on the background thread pool
+///
+/// One of these exists for each combination of provider and resolution the
+/// renderer uses, and it is cancelled when either changes. Jobs hold a
+/// reference to it, so it outlives the renderer if they haven't finished yet.
+class AudioSpectrumJobs final : public std::enable_shared_from_this<AudioSpectrumJobs> {
+	using BlockType = AudioSpectrumCacheBlockFactory::BlockType;
+
+	AudioSpectrumRenderer *renderer;
+	agi::AudioProvider *provider;
+	/// Where to also store the blocks, if anywhere
+	AudioSpectrumDiskCache *disk_cache;
+	size_t derivation_size;
+	size_t derivation_dist;
+	/// Because the FFTs used here are unnormalized DFTs, we have to compensate
+	/// the possible length difference between derivation_size used in the
+	/// calculations and its user-provided counterpart. Thus, the display is
+	/// kept independent of the sampling rate.
+	float scale_fix;
+
+	std::mutex lock;
+	/// Signalled whenever a job finishes
+	std::condition_variable idle;
+	/// Set when the renderer no longer wants any results
+	std::atomic<bool> cancelled{false};
+	/// Number of jobs currently running
+	int running = 0;
+	/// Has a call to PublishBlocks been queued on the GUI thread?
+	bool publish_queued = false;
+	/// Workspaces which aren't currently in use by a job
+	std::vector<std::unique_ptr<AudioSpectrumWorkspace>> workspaces;
+	/// Computed blocks which haven't been handed to the renderer yet
+	std::vector<std::pair<size_t, BlockType>> finished;
+
+	/// Number of blocks computed since the last call to TakeStats
+	size_t blocks_computed = 0;
+	/// Time spent computing them, summed over all threads
+	std::chrono::steady_clock::duration compute_time{};
+
+	/// Compute some blocks; runs on a background thread
+	void Run(std::vector<size_t> const& blocks)
+	{
+		std::unique_ptr<AudioSpectrumWorkspace> workspace;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (cancelled) return;
+			++running;
+			if (!workspaces.empty())
+			{
+				workspace = std::move(workspaces.back());
+				workspaces.pop_back();
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		if (!workspace)
+			workspace = std::make_unique<AudioSpectrumWorkspace>(derivation_size);
+
+		std::vector<std::pair<size_t, BlockType>> results;
+		results.reserve(blocks.size());
+		for (size_t block_index : blocks)
+		{
+			if (cancelled) break;
+			BlockType block(new float[((size_t)1)<<derivation_size]);
+			int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
+			workspace->FillBlock(provider, first_sample, scale_fix, block.get());
+
+			// Blocks which include audio which hasn't been decoded yet will
+			// be wrong once it is, so they can't be kept
+			int64_t last_sample = std::min(first_sample + (2 << derivation_size), provider->GetNumSamples());
+			if (disk_cache && last_sample <= provider->GetDecodedSamples())
+				disk_cache->Write(block_index, block.get());
+
+			results.emplace_back(block_index, std::move(block));
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		bool queue_publish = false;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			workspaces.push_back(std::move(workspace));
+			blocks_computed += results.size();
+			compute_time += elapsed;
+			for (auto& result : results)
+				finished.push_back(std::move(result));
+			if (!finished.empty() && !publish_queued)
+				queue_publish = publish_queued = true;
+			--running;
+		}
+		idle.notify_all();
+
+		if (queue_publish)
+		{
+			agi::dispatch::Main().Async([self = shared_from_this()] {
+				// Cancellation happens on the GUI thread, so if this hasn't
+				// been cancelled the renderer is still alive
+				if (!self->cancelled)
+					self->renderer->PublishBlocks();
+			});
+		}
+	}
+
+public:
+	AudioSpectrumJobs(AudioSpectrumRenderer *renderer, agi::AudioProvider *provider, AudioSpectrumDiskCache *disk_cache, size_t derivation_size, size_t derivation_size_user, size_t derivation_dist)
+	: renderer(renderer)
+	, provider(provider)
+	, disk_cache(disk_cache)
+	, derivation_size(derivation_size)
+	, derivation_dist(derivation_dist)
+	, scale_fix(1.f / sqrtf(float(1 << (derivation_size - derivation_size_user))))
+	{
+	}
+
+	/// Queue the given blocks to be computed on the background thread pool
+	void Queue(std::vector<size_t> const& blocks)
+	{
+		for (size_t i = 0; i < blocks.size(); i += blocks_per_job)
+		{
+			std::vector<size_t> batch(blocks.begin() + i, blocks.begin() + std::min(i + blocks_per_job, blocks.size()));
+			agi::dispatch::Background().Async([self = shared_from_this(), batch = std::move(batch)] {
+				self->Run(batch);
+			});
+		}
+	}
+
+	/// Take all of the blocks which have been computed so far
+	std::vector<std::pair<size_t, BlockType>> TakeFinished()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		publish_queued = false;
+		auto ret = std::move(finished);
+		finished.clear();
+		return ret;
+	}
+
+	/// Get the number of blocks computed and the time spent on them, then reset both
+	std::pair<size_t, double> TakeStats()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		std::pair<size_t, double> ret(blocks_computed, std::chrono::duration<double>(compute_time).count());
+		blocks_computed = 0;
+		compute_time = {};
+		return ret;
+	}
+
+	/// Discard all pending work and wait for any running jobs to finish
+	///
+	/// Must be called before the renderer or the audio provider are destroyed.
+	void Cancel()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		cancelled = true;
+		idle.wait(guard, [&] { return running == 0; });
+	}
+};
+
+AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_name)
+{
+	colors.reserve(AudioStyle_MAX);
+	for (int i = 0; i < AudioStyle_MAX; ++i)
+		colors.emplace_back(12, color_scheme_name, i);
 }
 
-void AudioSpectrumRenderer::OnSetProvider()
+AudioSpectrumRenderer::~AudioSpectrumRenderer()
 {
+	// This sequence will clean up
+	provider = nullptr;
 	RecreateCache();
 }
 
-void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _derivation_dist)
+void AudioSpectrumRenderer::RecreateCache()
 {
-	if (derivation_dist_user != _derivation_dist)
+	if (jobs)
 	{
-		derivation_dist_user = _derivation_dist;
-		update_derivation_values ();
-		AgeCache (0);
+		jobs->Cancel();
+		jobs.reset();
+	}
+
+	update_derivation_values ();
+
+	cache.reset();
+	disk_cache.reset();
+	requested.clear();
+	outstanding = 0;
+
+	if (provider)
+	{
+		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+		cache = std::make_unique<AudioSpectrumCache>(block_count, this);
+		requested.resize(block_count);
+		OpenDiskCache(block_count);
+		jobs = std::make_shared<AudioSpectrumJobs>(this, provider, disk_cache.get(), derivation_size, derivation_size_user, derivation_dist);
+	}
+}
+
+void AudioSpectrumRenderer::OpenDiskCache(size_t block_count)
+{
+	if (disk_cache_base.empty())
+		return;
+
+	size_t bins = (size_t)1 << derivation_size;
+	uint64_t required = AudioSpectrumDiskCache::RequiredSize(bins, block_count);
+	if (required > disk_cache_max_size)
+	{
+		LOG_D("audio/renderer/spectrum") << "not using disk cache: " << required << " bytes needed";
+		return;
 	}
 
-	if (derivation_size_user != _derivation_size)
+	auto path = disk_cache_base;
+	path += "_" + std::to_string(derivation_size) + "_" + std::to_string(derivation_dist) + ".spectrum";
+	try
 	{
+		disk_cache = std::make_unique<AudioSpectrumDiskCache>(path, bins, block_count);
+	}
+	catch (agi::Exception const& e)
+	{
+		LOG_D("audio/renderer/spectrum") << "not using disk cache: " << e.GetMessage();
+	}
+	catch (std::bad_alloc const&)
+	{
+		LOG_D("audio/renderer/spectrum") << "not using disk cache: could not map " << required << " bytes";
+	}
+}
+
+void AudioSpectrumRenderer::SetDiskCache(agi::fs::path const& base, uint64_t max_size)
+{
+	disk_cache_base = base;
+	disk_cache_max_size = max_size;
+}
+
+float *AudioSpectrumRenderer::ReadDiskCache(size_t block_index)
+{
+	if (!disk_cache)
+		return nullptr;
+
+	AudioSpectrumCacheBlockFactory::BlockType block(new float[(size_t)1 << derivation_size]);
+	if (!disk_cache->Read(block_index, block.get()))
+		return nullptr;
+	cache->Insert(block_index, std::move(block));
+	return cache->TryGet(block_index);
+}
+
+int64_t AudioSpectrumRenderer::GetRenderableSamples() const
+{
+	if (disk_cache && disk_cache->IsComplete())
+		return provider->GetNumSamples();
+	return AudioRendererBitmapProvider::GetRenderableSamples();
+}
+
+void AudioSpectrumRenderer::OnSetProvider()
+{
+	RecreateCache();
+}
+
+void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _derivation_dist)
+{
+	// Both affect the layout of the cache, and any blocks currently being
+	// computed for the old values are useless
+	if (derivation_dist_user != _derivation_dist || derivation_size_user != _derivation_size)
+	{
+		derivation_dist_user = _derivation_dist;
 		derivation_size_user = _derivation_size;
 		RecreateCache();
 	}
@@ -166,15 +604,6 @@ void AudioSpectrumRenderer::set_reference_frequency_position (float pos_fref_)
 	pos_fref = pos_fref_;
 }
 
-
-template<class T>
-void AudioSpectrumRenderer::ConvertToFloat(size_t count, T *dest) {
-	for (size_t si = 0; si < count; ++si)
-	{
-		dest[si] = (T)(audio_scratch[si]) / 32768.0;
-	}
-}
-
 void AudioSpectrumRenderer::update_derivation_values ()
 {
 	// Below this sampling rate (Hz), the derivation values are identical to
@@ -201,55 +630,36 @@ void AudioSpectrumRenderer::update_derivation_values ()
 	}
 }
 
-void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
+void AudioSpectrumRenderer::RequestBlock(size_t block_index, std::vector<size_t> &to_queue)
 {
-	assert(cache);
-	assert(block);
-
-	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
-	provider->GetAudio(&audio_scratch[0], first_sample, 2 << derivation_size);
-
-	// Because the FFTs used here are unnormalized DFTs, we have to compensate
-	// the possible length difference between derivation_size used in the
-	// calculations and its user-provided counterpart. Thus, the display is
-	// kept independent of the sampling rate.
-	const float scale_fix =
-		1.f / sqrtf (float (1 << (derivation_size - derivation_size_user)));
-
-#ifdef WITH_FFTW3
-	ConvertToFloat(2 << derivation_size, dft_input);
-
-	fftw_execute(dft_plan);
+	if (block_index >= requested.size() || requested[block_index])
+		return;
+	requested[block_index] = true;
+	++outstanding;
+	to_queue.push_back(block_index);
+}
 
-	double scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
+void AudioSpectrumRenderer::PublishBlocks()
+{
+	auto blocks = jobs->TakeFinished();
+	if (blocks.empty()) return;
 
-	fftw_complex *o = dft_output;
-	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+	for (auto& block : blocks)
 	{
-		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
-		o++;
+		requested[block.first] = false;
+		cache->Insert(block.first, std::move(block.second));
 	}
-#else
-	ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
-
-	float *fft_input = &fft_scratch[0];
-	float *fft_real = &fft_scratch[0] + (2 << derivation_size);
-	float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
 
-	FFT fft;
-	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
-
-	float scale_factor = scale_fix * 9 / sqrt(2 * (float)(2<<derivation_size));
-
-	for (size_t si = 1<<derivation_size; si > 0; --si)
+	outstanding -= std::min(outstanding, blocks.size());
+	if (outstanding == 0)
 	{
-		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
-		// although the FFT output can apparently get greater magnitudes than 1
-		// despite the input being limited to [-1;+1).
-		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
-		fft_real++; fft_imag++;
+		auto stats = jobs->TakeStats();
+		if (stats.second > 0)
+			LOG_D("audio/renderer/spectrum") << "computed " << stats.first << " blocks at "
+				<< (size_t)(stats.first / stats.second) << " blocks/s per core";
 	}
-#endif
+
+	AnnounceBlocksReady();
 }
 
 void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
@@ -307,16 +717,34 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	float log_ratio_calc = (b_fref - clin) / (clog - clin);
 	log_ratio_calc       = mid (0.f, log_ratio_calc, 1.f);
 
+	auto block_for_column = [&](int ax) {
+		return (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+	};
+
+	// Blocks which need to be computed
+	std::vector<size_t> to_queue;
+
 	// ax = absolute x, absolute to the virtual spectrum bitmap
 	for (int ax = start; ax < end; ++ax)
 	{
 		// Derived audio data
-		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
-		float *power = &cache->Get(block_index);
+		size_t block_index = block_for_column(ax);
+		float *power = cache->TryGet(block_index);
+		if (!power)
+			power = ReadDiskCache(block_index);
 
 		// Prepare bitmap writing
 		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
 
+		// Draw silence until the block has been computed
+		if (!power)
+		{
+			RequestBlock(block_index, to_queue);
+			for (int y = 0; y < imgheight; ++y, px -= stride)
+				pal->map(0.f, px);
+			continue;
+		}
+
 		float bin_prv = minband;
 		float bin_cur = minband;
 		for (int y = 0; y < imgheight; ++y)
@@ -365,6 +793,23 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 		}
 	}
 
+	// Get a head start on the blocks which are likely to be needed next,
+	// stopping at audio which hasn't been decoded yet as blocks for that would
+	// just be silence
+	const int64_t decoded = provider->GetDecodedSamples();
+	for (int ax = end; ax < end + lookahead_columns; ++ax)
+	{
+		size_t block_index = block_for_column(ax);
+		if (block_index >= requested.size()) break;
+		if (requested[block_index] || cache->TryGet(block_index)) continue;
+		if (ReadDiskCache(block_index)) continue;
+		if ((((int64_t)block_index << derivation_dist) + ((int64_t)1 << derivation_size)) > decoded) break;
+		RequestBlock(block_index, to_queue);
+	}
+
+	if (!to_queue.empty())
+		jobs->Queue(to_queue);
+
 	wxBitmap tmpbmp(img);
 	wxMemoryDC targetdc(bmp);
 	targetdc.DrawBitmap(tmpbmp, 0, 0);
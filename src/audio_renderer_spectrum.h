@@ -39,12 +39,13 @@
 
 #include "audio_renderer.h"
 
-#ifdef WITH_FFTW3
-#include <fftw3.h>
-#endif
+#include <libaegisub/fs.h>
+#include <libaegisub/signal.h>
 
 class AudioColorScheme;
 class AudioSpectrumCache;
+class AudioSpectrumDiskCache;
+class AudioSpectrumJobs;
 struct AudioSpectrumCacheBlockFactory;
 
 /// @class AudioSpectrumRenderer
@@ -52,12 +53,37 @@ struct AudioSpectrumCacheBlockFactory;
 ///
 /// Renders frequency-power spectrum graphs of PCM audio data using a derivation function
 /// such as the fast fourier transform.
+///
+/// The derivations are done on the background thread pool. Columns whose data
+/// isn't ready yet are rendered as silence, and AnnounceBlocksReady is
+/// signalled when more data has arrived and the display should be redrawn.
 class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	friend struct AudioSpectrumCacheBlockFactory;
+	friend class AudioSpectrumJobs;
 
 	/// Internal cache management for the spectrum
 	std::unique_ptr<AudioSpectrumCache> cache;
 
+	/// Derived data saved by previous sessions, if the disk cache is enabled
+	std::unique_ptr<AudioSpectrumDiskCache> disk_cache;
+
+	/// Path prefix for disk cache files, or empty to not use one
+	agi::fs::path disk_cache_base;
+
+	/// Largest disk cache file to create, in bytes
+	uint64_t disk_cache_max_size = 0;
+
+	/// Derivations currently being done in the background
+	std::shared_ptr<AudioSpectrumJobs> jobs;
+
+	/// Which blocks have been queued for derivation but not yet put in the cache
+	std::vector<bool> requested;
+
+	/// Number of entries in requested which are set
+	size_t outstanding = 0;
+
+	agi::signal::Signal<> AnnounceBlocksReady;
+
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
 
@@ -103,35 +129,26 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// e.g. new audio provider or new resolution.
 	void RecreateCache();
 
-	/// @brief Fill a block with frequency-power data for a time range
-	/// @param      block_index Index of the block to fill data for
-	/// @param[out] block       Address to write the data to
-	void FillBlock(size_t block_index, float *block);
+	/// @brief Open the disk cache file for the current provider and resolution
+	/// @param block_count Number of blocks in the cache
+	void OpenDiskCache(size_t block_count);
 
-	/// @brief Convert audio data to float range [-1;+1)
-	/// @param count Samples to convert
-	/// @param dest Buffer to fill
-	template<class T>
-	void ConvertToFloat(size_t count, T *dest);
+	/// @brief Copy a block from the disk cache into the in-memory cache
+	/// @param block_index Index of the block
+	/// @return The block, or null if it isn't in the disk cache
+	float *ReadDiskCache(size_t block_index);
+
+	/// @brief Queue a block for derivation if it hasn't been already
+	/// @param      block_index Index of the block
+	/// @param[out] to_queue    List of blocks to add it to
+	void RequestBlock(size_t block_index, std::vector<size_t> &to_queue);
+
+	/// @brief Move the blocks which have finished deriving into the cache
+	void PublishBlocks();
 
 	/// @brief Updates the derivation_* after a derivation_*_user change.
 	void update_derivation_values ();
 
-#ifdef WITH_FFTW3
-	/// FFTW plan data
-	fftw_plan dft_plan = nullptr;
-	/// Pre-allocated input array for FFTW
-	double *dft_input = nullptr;
-	/// Pre-allocated output array for FFTW
-	fftw_complex *dft_output = nullptr;
-#else
-	/// Pre-allocated scratch area for doing FFT derivations
-	std::vector<float> fft_scratch;
-#endif
-
-	/// Pre-allocated scratch area for storing raw audio data
-	std::vector<int16_t> audio_scratch;
-
 public:
 	/// @brief Constructor
 	/// @param color_scheme_name Name of the color scheme to use
@@ -160,6 +177,13 @@ public:
 	/// is specified too large, it will be clamped to the size.
 	void SetResolution(size_t derivation_size, size_t derivation_dist);
 
+	/// @brief Set where to keep derived data between sessions
+	/// @param base     Path prefix for the cache files, or empty to not use a disk cache
+	/// @param max_size Size in bytes above which a file is not worth creating
+	///
+	/// Takes effect the next time the audio provider or resolution changes.
+	void SetDiskCache(agi::fs::path const& base, uint64_t max_size);
+
 	/// @brief Set the vertical relative position of the reference frequency (1 kHz)
 	/// @param pos_fref_ Vertical position of the 1 kHz frequency. Between 0 and 1, boundaries excluded.
 	///
@@ -169,4 +193,10 @@ public:
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	void AgeCache(size_t max_size) override;
+
+	/// Everything can be drawn before the audio is decoded if all of it is
+	/// in the disk cache
+	int64_t GetRenderableSamples() const override;
+
+	DEFINE_SIGNAL_ADDERS(AnnounceBlocksReady, AddBlocksReadyListener)
 };
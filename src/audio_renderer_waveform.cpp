@@ -32,10 +32,13 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/audio/provider.h>
 
 #include <algorithm>
+#include <cstring>
 #include <wx/dcmemory.h>
+#include <wx/image.h>
 
 enum {
 	/// Only render the peaks
@@ -57,21 +60,51 @@ AudioWaveformRenderer::~AudioWaveformRenderer() { }
 
 void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
 {
-	wxMemoryDC dc(bmp);
-	wxRect rect(wxPoint(0, 0), bmp.GetSize());
-	int midpoint = rect.height / 2;
+	// Prepare an image buffer to write
+	wxImage img(bmp.GetSize());
+	unsigned char *imgdata = img.GetData();
+	const int width = img.GetWidth();
+	const int height = img.GetHeight();
+	const ptrdiff_t stride = width * 3;
+	int midpoint = height / 2;
 
 	const AudioColorScheme *pal = &colors[style];
 
-	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+	unsigned char color_bg[3], color_peaks[3], color_avgs[3], color_line[3];
+	pal->map(0.0f, color_bg);
+	pal->map(0.4f, color_peaks);
+	pal->map(0.7f, color_avgs);
+	pal->map(render_averages ? 1.0f : 0.4f, color_line);
+
+	// Draw a run of one column, with y_end exclusive
+	auto fill_column = [&](int x, int y_begin, int y_end, const unsigned char *color) {
+		y_begin = std::max(y_begin, 0);
+		y_end = std::min(y_end, height);
+		for (unsigned char *px = imgdata + y_begin * stride + x * 3; y_begin < y_end; ++y_begin, px += stride)
+			std::copy(color, color + 3, px);
+	};
 
 	// Fill the background
-	dc.SetBrush(wxBrush(pal->get(0.0f)));
-	dc.SetPen(*wxTRANSPARENT_PEN);
-	dc.DrawRectangle(rect);
+	if (width > 0 && height > 0) {
+		for (int x = 0; x < width; ++x)
+			std::copy(color_bg, color_bg + 3, imgdata + x * 3);
+		for (int y = 1; y < height; ++y)
+			memcpy(imgdata + y * stride, imgdata, stride);
+	}
+
+	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
 
-	// Make sure we've got a buffer to fill with audio data
-	if (!audio_buffer)
+	assert(provider->GetBytesPerSample() == 2);
+	assert(provider->GetChannels() == 1);
+
+	// Use the precomputed summary of the audio if the provider has one and
+	// we're zoomed out far enough for it to be useful
+	auto peaks = provider->GetPeaks();
+	if (peaks && pixel_samples < agi::AudioPeakPyramid::bucket_size)
+		peaks = nullptr;
+
+	// Otherwise we need a buffer to fill with audio data
+	if (!peaks && !audio_buffer)
 	{
 		// Buffer for one pixel strip of audio
 		size_t buffer_needed = pixel_samples * provider->GetChannels() * provider->GetBytesPerSample();
@@ -80,55 +113,47 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 
 	double cur_sample = start * pixel_samples;
 
-	assert(provider->GetBytesPerSample() == 2);
-	assert(provider->GetChannels() == 1);
-
-	wxPen pen_peaks(wxPen(pal->get(0.4f)));
-	wxPen pen_avgs(wxPen(pal->get(0.7f)));
-
-	for (int x = 0; x < rect.width; ++x)
+	for (int x = 0; x < width; ++x)
 	{
-		provider->GetAudio(audio_buffer.get(), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
-
-		int peak_min = 0, peak_max = 0;
-		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+		agi::AudioPeak peak;
+		if (peaks)
+			peak = peaks->Get((int64_t)cur_sample, (int64_t)(cur_sample + pixel_samples));
+		else
 		{
-			if (*aud > 0)
-			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
-			}
-			else
-			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
-			}
+			provider->GetAudio(audio_buffer.get(), (int64_t)cur_sample, (int64_t)pixel_samples);
+			peak = agi::ComputeAudioPeak(reinterpret_cast<const int16_t *>(audio_buffer.get()), (int64_t)pixel_samples);
 		}
+		cur_sample += pixel_samples;
 
 		// midpoint is half height
-		peak_min = std::max((int)(peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
-		peak_max = std::min((int)(peak_max * amplitude_scale * midpoint) / 0x8000, midpoint);
-		int avg_min = std::max((int)(avg_min_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, -midpoint);
-		int avg_max = std::min((int)(avg_max_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, midpoint);
-
-		dc.SetPen(pen_peaks);
-		dc.DrawLine(x, midpoint - peak_max, x, midpoint - peak_min);
-		if (render_averages) {
-			dc.SetPen(pen_avgs);
-			dc.DrawLine(x, midpoint - avg_max, x, midpoint - avg_min);
-		}
+		int peak_min = std::max((int)(peak.min * amplitude_scale * midpoint) / 0x8000, -midpoint);
+		int peak_max = std::min((int)(peak.max * amplitude_scale * midpoint) / 0x8000, midpoint);
+		int avg_min = std::max((int)(peak.avg_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
+		int avg_max = std::min((int)(peak.avg_max * amplitude_scale * midpoint) / 0x8000, midpoint);
+
+		fill_column(x, midpoint - peak_max, midpoint - peak_min, color_peaks);
+		if (render_averages)
+			fill_column(x, midpoint - avg_max, midpoint - avg_min, color_avgs);
 	}
 
 	// Horizontal zero-point line
-	if (render_averages)
-		dc.SetPen(wxPen(pal->get(1.0f)));
-	else
-		dc.SetPen(pen_peaks);
+	if (midpoint < height) {
+		for (int x = 0; x < width; ++x)
+			std::copy(color_line, color_line + 3, imgdata + midpoint * stride + x * 3);
+	}
 
-	dc.DrawLine(0, midpoint, rect.width, midpoint);
+	wxBitmap tmpbmp(img);
+	wxMemoryDC targetdc(bmp);
+	targetdc.DrawBitmap(tmpbmp, 0, 0);
+}
+
+int64_t AudioWaveformRenderer::GetRenderableSamples() const
+{
+	int64_t decoded = AudioRendererBitmapProvider::GetRenderableSamples();
+	auto peaks = provider ? provider->GetPeaks() : nullptr;
+	if (peaks && pixel_ms * provider->GetSampleRate() / 1000.0 >= agi::AudioPeakPyramid::bucket_size)
+		return std::max(decoded, peaks->GetReadySamples());
+	return decoded;
 }
 
 void AudioWaveformRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style)
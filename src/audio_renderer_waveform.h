@@ -40,7 +40,8 @@ class AudioWaveformRenderer final : public AudioRendererBitmapProvider {
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
 
-	/// Pre-allocated buffer for audio fetched from provider
+	/// Pre-allocated buffer for audio fetched from provider, when its precomputed
+	/// peaks can't be used
 	std::unique_ptr<char[]> audio_buffer;
 
 	/// Whether to render max+avg or just max
@@ -72,6 +73,10 @@ public:
 	/// Does nothing for waveform renderer, since it does not have a backend cache
 	void AgeCache(size_t) override { }
 
+	/// Includes the precomputed peaks when they can be used, which may have
+	/// been loaded from the disk cache before the audio was decoded
+	int64_t GetRenderableSamples() const override;
+
 	/// Get a list of waveform rendering modes
 	static wxArrayString GetWaveformStyles();
 };
@@ -380,8 +380,13 @@ class AudioTimingControllerDialogue final : public AudioTimingController, privat
 
 	void OnSelectedSetChanged();
 
+	/// Update the markers of an inactive line whose times were changed by
+	/// something else
+	/// @return Was the line an inactive line
+	bool UpdateInactiveLine(const AssDialogue *line);
+
 	// AssFile events
-	void OnFileChanged(int type);
+	void OnFileChanged(int type, const AssDialogue *changed);
 
 public:
 	// AudioMarkerProvider interface
@@ -455,7 +460,12 @@ void AudioTimingControllerDialogue::OnSelectedSetChanged()
 	RegenerateInactiveLines();
 }
 
-void AudioTimingControllerDialogue::OnFileChanged(int type) {
+void AudioTimingControllerDialogue::OnFileChanged(int type, const AssDialogue *changed) {
+	// Moving one inactive line doesn't affect any of the others, so there's
+	// no need to rebuild the markers for every line in the file
+	if (type == AssFile::COMMIT_DIAG_TIME && changed && modified_lines.empty() && UpdateInactiveLine(changed))
+		return;
+
 	if (type & AssFile::COMMIT_DIAG_TIME)
 		Revert();
 	else if (type & AssFile::COMMIT_DIAG_ADDREM)
@@ -772,6 +782,27 @@ void AudioTimingControllerDialogue::AddInactiveLine(Selection const& sel, AssDia
 	inactive_lines.back().SetLine(diag);
 }
 
+bool AudioTimingControllerDialogue::UpdateInactiveLine(const AssDialogue *diag)
+{
+	auto line = boost::find_if(inactive_lines, [&](TimeableLine const& l) { return l.GetLine() == diag; });
+	if (line == inactive_lines.end()) return false;
+
+	commit_id = -1;
+
+	auto left = line->GetLeftMarker(), right = line->GetRightMarker();
+	markers.erase(remove_if(markers.begin(), markers.end(), [&](DialogueTimingMarker *m) {
+		return m == left || m == right;
+	}), markers.end());
+
+	line->SetLine(line->GetLine());
+	for (auto marker : {line->GetLeftMarker(), line->GetRightMarker()})
+		markers.insert(boost::upper_bound(markers, marker->GetPosition(), marker_ptr_cmp()), marker);
+
+	AnnounceUpdatedStyleRanges();
+	AnnounceMarkerMoved();
+	return true;
+}
+
 void AudioTimingControllerDialogue::RegenerateSelectedLines()
 {
 	bool was_empty = selected_lines.empty();
@@ -308,7 +308,6 @@ namespace Automation4 {
 	AutoloadScriptManager::AutoloadScriptManager(std::string path)
 	: path(std::move(path))
 	{
-		Reload();
 	}
 
 	void AutoloadScriptManager::Reload()
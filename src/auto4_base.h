@@ -218,6 +218,7 @@ namespace Automation4 {
 	class AutoloadScriptManager final : public ScriptManager {
 		std::string path;
 	public:
+		/// Scripts in path aren't loaded until Reload is called
 		AutoloadScriptManager(std::string path);
 		void Reload() override;
 	};
@@ -483,7 +483,7 @@ namespace {
 
 		// Replace the default lua module loader with our unicode compatible
 		// one and set the module search path
-		if (!Install(L, include_path)) {
+		if (!Install(L, include_path, config::path->Decode("?local/luacache/"))) {
 			description = get_string_or_default(L, 1);
 			lua_pop(L, 1);
 			return;
@@ -1091,6 +1091,7 @@ namespace Automation4 {
 	LuaScriptFactory::LuaScriptFactory()
 	: ScriptFactory("Lua", "*.lua,*.moon")
 	{
+		CleanCache(config::path->Decode("?local/luacache/"), "*.luac", 64, 1000);
 	}
 
 	std::unique_ptr<Script> LuaScriptFactory::Produce(agi::fs::path const& filename) const
@@ -33,6 +33,7 @@
 #include <vector>
 #include <wx/string.h>
 
+class AssDialogue;
 class AssEntry;
 class wxControl;
 class wxWindow;
@@ -81,6 +82,12 @@ namespace Automation4 {
 		/// Lines that were allocated here and need to be deleted if the script is cancelled.
 		std::vector<AssEntry *> allocated_lines;
 
+		/// Registry reference to a weak-keyed table mapping the dialogue line
+		/// tables given to the script to the AssDialogue they were made from
+		int line_sources;
+		/// Drop the line source table once the lines in it may no longer be valid
+		void ReleaseLineSources();
+
 		/// Create copies of all of the lines in the script info section if it
 		/// hasn't already happened. This is done lazily, since it only needs
 		/// to happen when the user modifies the headers in some way, which
@@ -90,6 +97,9 @@ namespace Automation4 {
 		/// when the script completes, unless it's an AssInfo, since those are
 		/// owned by the container.
 		void QueueLineForDeletion(size_t idx);
+		/// Take ownership of a line created from a Lua table in the appropriate
+		/// way for its type, and return a pointer to it to put in lines
+		AssEntry *AdoptLine(std::unique_ptr<AssEntry> e);
 		/// Set the line at the index to the given value
 		void AssignLine(size_t idx, std::unique_ptr<AssEntry> e);
 		void InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e);
@@ -101,6 +111,7 @@ namespace Automation4 {
 		void ObjectDeleteRange(lua_State *L);
 		void ObjectAppend(lua_State *L);
 		void ObjectInsert(lua_State *L);
+		void ObjectBatch(lua_State *L);
 		void ObjectGarbageCollect(lua_State *L);
 		int ObjectIPairs(lua_State *L);
 		int IterNext(lua_State *L);
@@ -118,7 +129,9 @@ namespace Automation4 {
 		/// makes a Lua representation of AssEntry and places on the top of the stack
 		void AssEntryToLua(lua_State *L, size_t idx);
 		/// assumes a Lua representation of AssEntry on the top of the stack, and creates an AssEntry object of it
-		static std::unique_ptr<AssEntry> LuaToAssEntry(lua_State *L, AssFile *ass=nullptr);
+		/// @param source Line the table was made from, if known, which is used
+		///               as the starting point for a dialogue line
+		static std::unique_ptr<AssEntry> LuaToAssEntry(lua_State *L, AssFile *ass=nullptr, AssDialogue const *source=nullptr);
 
 		std::unique_ptr<AssEntry> LuaToTrackedAssEntry(lua_State *L);
 
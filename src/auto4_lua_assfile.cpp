@@ -77,6 +77,36 @@ namespace {
 		return ret;
 	}
 
+	/// Set a string field of a line, skipping the flyweight lookup if the value
+	/// is unchanged
+	void set_string_field(lua_State *L, boost::flyweight<std::string> &field, const char *name, const char *line_class)
+	{
+		get_field(L, name, line_class, lua_isstring);
+		std::string_view value(lua_tostring(L, -1), lua_strlen(L, -1));
+		if (value != field.get())
+			field = std::string(value);
+		lua_pop(L, 1);
+	}
+
+	/// Check if the extradata table on the top of the stack has exactly the
+	/// same entries as the given line
+	bool same_extradata(lua_State *L, AssFile *ass, AssDialogue const& line)
+	{
+		auto entries = ass->GetExtradata(line.ExtradataIds);
+		size_t count = 0;
+		bool same = true;
+		lua_for_each(L, [&] {
+			if (lua_type(L, -2) != LUA_TSTRING) return;
+			auto key = get_string_or_default(L, -2);
+			auto value = get_string_or_default(L, -1);
+			same = ++count <= entries.size() && std::any_of(begin(entries), end(entries), [&](ExtradataEntry const& ed) {
+				return ed.key == key && ed.value == value;
+			});
+			if (!same) throw LuaForEachBreak();
+		});
+		return same && count == entries.size();
+	}
+
 	agi::Color get_color_field(lua_State *L, const char *name, const char *line_class)
 	{
 		get_field(L, name, line_class, lua_isstring);
@@ -158,21 +188,26 @@ namespace Automation4 {
 
 	void LuaAssFile::AssEntryToLua(lua_State *L, size_t idx)
 	{
-		lua_newtable(L);
-
 		const AssEntry *e = lines[idx];
 		if (!e)
 			e = &ass->Info[idx];
 
+		auto info = check_cast_constptr<AssInfo>(e);
+		auto dia = info ? nullptr : check_cast_constptr<AssDialogue>(e);
+
+		// Size the table for the fields it's about to get so that filling it
+		// in doesn't have to repeatedly rehash it
+		lua_createtable(L, 0, info ? 5 : dia ? 16 : 28);
+
 		set_field(L, "section", e->GroupHeader());
 
-		if (auto info = check_cast_constptr<AssInfo>(e)) {
+		if (info) {
 			set_field(L, "raw", info->GetEntryData());
 			set_field(L, "key", info->Key());
 			set_field(L, "value", info->Value());
 			set_field(L, "class", "info");
 		}
-		else if (auto dia = check_cast_constptr<AssDialogue>(e)) {
+		else if (dia) {
 			set_field(L, "raw", dia->GetEntryData());
 			set_field(L, "comment", dia->Comment);
 
@@ -193,15 +228,28 @@ namespace Automation4 {
 			set_field(L, "text", dia->Text);
 
 			// create extradata table
-			lua_newtable(L);
-			for (auto const& ed : ass->GetExtradata(dia->ExtradataIds)) {
-				push_value(L, ed.key);
-				push_value(L, ed.value);
-				lua_settable(L, -3);
+			auto const& extradata_ids = dia->ExtradataIds.get();
+			lua_createtable(L, 0, extradata_ids.size());
+			if (!extradata_ids.empty()) {
+				for (auto const& ed : ass->GetExtradata(extradata_ids)) {
+					push_value(L, ed.key);
+					push_value(L, ed.value);
+					lua_settable(L, -3);
+				}
 			}
 			lua_setfield(L, -2, "extra");
 
 			set_field(L, "class", "dialogue");
+
+			// Remember which line the table came from so that writing it back
+			// can start from a copy of that line rather than from scratch
+			if (line_sources != LUA_NOREF) {
+				lua_rawgeti(L, LUA_REGISTRYINDEX, line_sources);
+				lua_pushvalue(L, -2);
+				lua_pushlightuserdata(L, const_cast<AssDialogue *>(dia));
+				lua_rawset(L, -3);
+				lua_pop(L, 1);
+			}
 		}
 		else if (auto sty = check_cast_constptr<AssStyle>(e)) {
 			set_field(L, "raw", sty->GetEntryData());
@@ -249,7 +297,7 @@ namespace Automation4 {
 		}
 	}
 
-	std::unique_ptr<AssEntry> LuaAssFile::LuaToAssEntry(lua_State *L, AssFile *ass)
+	std::unique_ptr<AssEntry> LuaAssFile::LuaToAssEntry(lua_State *L, AssFile *ass, AssDialogue const *source)
 	{
 		// assume an assentry table is on the top of the stack
 		// convert it to a real AssEntry object, and pop the table from the stack
@@ -299,26 +347,29 @@ namespace Automation4 {
 		}
 		else if (lclass == "dialogue") {
 			assert(ass != nullptr); // since we need AssFile::AddExtradata
-			auto dia = new AssDialogue;
+			auto dia = source ? new AssDialogue(*source) : new AssDialogue;
 			result.reset(dia);
 
 			dia->Comment = get_bool_field(L, "comment", "dialogue");
 			dia->Layer = get_int_field(L, "layer", "dialogue");
 			dia->Start = get_int_field(L, "start_time", "dialogue");
 			dia->End = get_int_field(L, "end_time", "dialogue");
-			dia->Style = get_string_field(L, "style", "dialogue");
-			dia->Actor = get_string_field(L, "actor", "dialogue");
+			set_string_field(L, dia->Style, "style", "dialogue");
+			set_string_field(L, dia->Actor, "actor", "dialogue");
 			dia->Margin[0] = get_int_field(L, "margin_l", "dialogue");
 			dia->Margin[1] = get_int_field(L, "margin_r", "dialogue");
 			dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
-			dia->Effect = get_string_field(L, "effect", "dialogue");
-			dia->Text = get_string_field(L, "text", "dialogue");
+			set_string_field(L, dia->Effect, "effect", "dialogue");
+			set_string_field(L, dia->Text, "text", "dialogue");
 
 			std::vector<uint32_t> new_ids;
 
 			lua_getfield(L, -1, "extra");
 			auto type = lua_type(L, -1);
-			if (type == LUA_TTABLE) {
+			if (type == LUA_TTABLE && source && same_extradata(L, ass, *source)) {
+				// Unchanged, so keep the ids copied from the source line
+			}
+			else if (type == LUA_TTABLE) {
 				lua_for_each(L, [&] {
 					if (lua_type(L, -2) != LUA_TSTRING) return;
 					new_ids.push_back(ass->AddExtradata(
@@ -328,7 +379,11 @@ namespace Automation4 {
 				std::sort(begin(new_ids), end(new_ids));
 				dia->ExtradataIds = std::move(new_ids);
 			}
-			else if (type != LUA_TNIL) {
+			else if (type == LUA_TNIL) {
+				if (source)
+					dia->ExtradataIds = std::move(new_ids);
+			}
+			else {
 				error(L, "dialogue extradata must be a table");
 			}
 		}
@@ -341,7 +396,20 @@ namespace Automation4 {
 	}
 
 	std::unique_ptr<AssEntry> LuaAssFile::LuaToTrackedAssEntry(lua_State *L) {
-		std::unique_ptr<AssEntry> e = LuaToAssEntry(L, ass);
+		// Tables which came from AssEntryToLua are almost always written back
+		// with only a field or two changed, so look up the line they were made
+		// from. Those lines stay alive until processing completes, as lines
+		// replaced or deleted by the script are only queued for deletion.
+		AssDialogue const *source = nullptr;
+		if (line_sources != LUA_NOREF && lua_istable(L, -1)) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, line_sources);
+			lua_pushvalue(L, -2);
+			lua_rawget(L, -2);
+			source = static_cast<AssDialogue const *>(lua_touserdata(L, -1));
+			lua_pop(L, 2);
+		}
+
+		std::unique_ptr<AssEntry> e = LuaToAssEntry(L, ass, source);
 		allocated_lines.push_back(e.get());
 		return e;
 	}
@@ -378,6 +446,8 @@ namespace Automation4 {
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectInsert, false>, 1);
 				else if (strcmp(idx, "append") == 0)
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectAppend, false>, 1);
+				else if (strcmp(idx, "batch") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectBatch, false>, 1);
 				else if (strcmp(idx, "script_resolution") == 0)
 					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::LuaGetScriptResolution>, 1);
 				else {
@@ -420,28 +490,26 @@ namespace Automation4 {
 			lines_to_delete.emplace_back(lines[idx]);
 	}
 
-	void LuaAssFile::AssignLine(size_t idx, std::unique_ptr<AssEntry> e)
+	AssEntry *LuaAssFile::AdoptLine(std::unique_ptr<AssEntry> e)
 	{
-		auto group = e->Group();
-		if (group == AssEntryGroup::INFO)
+		auto ret = e.get();
+		if (e->Group() == AssEntryGroup::INFO) {
 			InitScriptInfoIfNeeded();
-		lines[idx] = e.get();
-		if (group == AssEntryGroup::INFO)
 			lines_to_delete.emplace_back(std::move(e));
+		}
 		else
 			e.release();
+		return ret;
+	}
+
+	void LuaAssFile::AssignLine(size_t idx, std::unique_ptr<AssEntry> e)
+	{
+		lines[idx] = AdoptLine(std::move(e));
 	}
 
 	void LuaAssFile::InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e)
 	{
-		auto group = e->Group();
-		if (group == AssEntryGroup::INFO)
-			InitScriptInfoIfNeeded();
-		vec.insert(vec.begin() + idx, e.get());
-		if (group == AssEntryGroup::INFO)
-			lines_to_delete.emplace_back(std::move(e));
-		else
-			e.release();
+		vec.insert(vec.begin() + idx, AdoptLine(std::move(e)));
 	}
 
 	void LuaAssFile::ObjectIndexWrite(lua_State *L)
@@ -612,6 +680,159 @@ namespace Automation4 {
 		lines.insert(lines.begin() + before - 1, new_entries.begin(), new_entries.end());
 	}
 
+	void LuaAssFile::ObjectBatch(lua_State *L)
+	{
+		CheckAllowModify();
+
+		if (!lua_istable(L, 1))
+			error(L, "subs.batch expects a table of changes");
+
+		const size_t size = lines.size();
+		std::vector<bool> remove(size);
+		std::vector<AssEntry *> replace(size);
+		// Lines to insert and the index of the line to insert them before
+		std::vector<std::pair<size_t, AssEntry *>> insert;
+		std::vector<AssEntry *> append;
+
+		// Convert the line table on the top of the stack, leaving the stack
+		// as it was
+		auto read_line = [&] {
+			int top = lua_gettop(L);
+			lua_pushvalue(L, -1);
+			auto e = AdoptLine(LuaToTrackedAssEntry(L));
+			lua_settop(L, top);
+			return e;
+		};
+
+		auto get_list = [&](const char *name) {
+			lua_getfield(L, 1, name);
+			if (lua_isnil(L, -1)) return false;
+			if (!lua_istable(L, -1))
+				error(L, "Field '%s' of subs.batch changes must be a table", name);
+			return true;
+		};
+
+		if (get_list("delete")) {
+			lua_for_each(L, [&] {
+				size_t n = check_uint(L, -1);
+				if (n == 0 || n > size)
+					error(L, "Out of range line index in subs.batch delete: %d", (int)n);
+				remove[n - 1] = true;
+			});
+		}
+		lua_pop(L, 1);
+
+		if (get_list("replace")) {
+			lua_for_each(L, [&] {
+				size_t n = check_uint(L, -2);
+				if (n == 0 || n > size)
+					error(L, "Out of range line index in subs.batch replace: %d", (int)n);
+				if (remove[n - 1])
+					error(L, "Line %d is both replaced and deleted in subs.batch", (int)n);
+				replace[n - 1] = read_line();
+			});
+		}
+		lua_pop(L, 1);
+
+		if (get_list("insert")) {
+			lua_for_each(L, [&] {
+				size_t n = check_uint(L, -2);
+				// + 1 to allow inserting at the end of the file
+				if (n == 0 || n > size + 1)
+					error(L, "Out of range line index in subs.batch insert: %d", (int)n);
+				if (!lua_istable(L, -1))
+					error(L, "Lines to insert with subs.batch must be in a table");
+				for (int i = 1, count = static_cast<int>(lua_objlen(L, -1)); i <= count; ++i) {
+					lua_rawgeti(L, -1, i);
+					insert.emplace_back(n - 1, read_line());
+					lua_pop(L, 1);
+				}
+			});
+			// The lines for each index were added together, so a stable sort
+			// keeps them in the order given
+			std::stable_sort(begin(insert), end(insert), [](auto const& a, auto const& b) {
+				return a.first < b.first;
+			});
+		}
+		lua_pop(L, 1);
+
+		if (get_list("append")) {
+			for (int i = 1, count = static_cast<int>(lua_objlen(L, -1)); i <= count; ++i) {
+				lua_rawgeti(L, -1, i);
+				append.push_back(read_line());
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 1);
+
+		// Copy the script info before building the new list of lines so that
+		// the lines copied into it are the copies
+		for (size_t i = 0; i < size; ++i) {
+			if ((remove[i] || replace[i]) && (!lines[i] || lines[i]->Group() == AssEntryGroup::INFO)) {
+				InitScriptInfoIfNeeded();
+				break;
+			}
+		}
+
+		std::vector<AssEntry *> merged;
+		merged.reserve(size + insert.size() + append.size());
+		auto next_insert = begin(insert);
+		for (size_t i = 0; i <= size; ++i) {
+			for (; next_insert != end(insert) && next_insert->first == i; ++next_insert) {
+				modification_type |= modification_mask(next_insert->second);
+				merged.push_back(next_insert->second);
+			}
+			if (i == size) break;
+
+			if (remove[i] || replace[i]) {
+				modification_type |= modification_mask(lines[i]);
+				QueueLineForDeletion(i);
+			}
+			if (replace[i]) {
+				modification_type |= modification_mask(replace[i]);
+				merged.push_back(replace[i]);
+			}
+			else if (!remove[i])
+				merged.push_back(lines[i]);
+		}
+
+		if (!append.empty()) {
+			// As with subs.append, each appended line goes after the last line
+			// of its section, or at the end of the file if there are none
+			using group_type = std::underlying_type_t<AssEntryGroup>;
+			auto group_of = [](AssEntry *e) {
+				return static_cast<group_type>(e ? e->Group() : AssEntryGroup::INFO);
+			};
+
+			std::vector<AssEntry *> by_group[static_cast<size_t>(AssEntryGroup::GROUP_MAX)];
+			std::vector<group_type> new_groups;
+			size_t last[static_cast<size_t>(AssEntryGroup::GROUP_MAX)] = {};
+			for (size_t i = 0; i < merged.size(); ++i)
+				last[group_of(merged[i])] = i + 1;
+			for (auto e : append) {
+				modification_type |= modification_mask(e);
+				auto group = group_of(e);
+				if (!last[group] && by_group[group].empty())
+					new_groups.push_back(group);
+				by_group[group].push_back(e);
+			}
+
+			std::vector<AssEntry *> with_appended;
+			with_appended.reserve(merged.size() + append.size());
+			for (size_t i = 0; i < merged.size(); ++i) {
+				with_appended.push_back(merged[i]);
+				auto group = group_of(merged[i]);
+				if (last[group] == i + 1)
+					with_appended.insert(end(with_appended), begin(by_group[group]), end(by_group[group]));
+			}
+			for (auto group : new_groups)
+				with_appended.insert(end(with_appended), begin(by_group[group]), end(by_group[group]));
+			merged = std::move(with_appended);
+		}
+
+		lines = std::move(merged);
+	}
+
 	void LuaAssFile::ObjectGarbageCollect(lua_State *)
 	{
 		references--;
@@ -743,6 +964,7 @@ namespace Automation4 {
 			ass->Commit(undo_description, modification_type);
 
 		lines_to_delete.clear();
+		ReleaseLineSources();
 
 		auto ret = std::move(lines);
 		references--;
@@ -754,10 +976,17 @@ namespace Automation4 {
 	{
 		for (auto& line : lines_to_delete) line.release();
 		for (AssEntry *line : allocated_lines) delete line;
+		ReleaseLineSources();
 		references--;
 		if (!references) delete this;
 	}
 
+	void LuaAssFile::ReleaseLineSources()
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, line_sources);
+		line_sources = LUA_NOREF;
+	}
+
 	LuaAssFile::LuaAssFile(lua_State *L, AssFile *ass, bool can_modify, bool can_set_undo)
 	: ass(ass)
 	, L(L)
@@ -771,6 +1000,18 @@ namespace Automation4 {
 		for (auto& line : ass->Events)
 			lines.push_back(&line);
 
+		// Line tables are only needed as keys for as long as the script is
+		// holding on to them, so the map of them to their source lines is
+		// weak-keyed
+		line_sources = LUA_NOREF;
+		if (can_modify) {
+			lua_newtable(L);
+			lua_createtable(L, 0, 1);
+			set_field(L, "__mode", "k");
+			lua_setmetatable(L, -2);
+			line_sources = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
 		// prepare userdata object
 		*static_cast<LuaAssFile**>(lua_newuserdata(L, sizeof(LuaAssFile*))) = this;
 
@@ -45,9 +45,11 @@
 #include "subs_controller.h"
 #include "video_controller.h"
 
+#include <libaegisub/log.h>
 #include <libaegisub/util.h>
 
 #include <algorithm>
+#include <chrono>
 
 #include <wx/dcbuffer.h>
 #include <wx/menu.h>
@@ -60,6 +62,12 @@ enum {
 	MENU_SHOW_COL = (wxID_HIGHEST + 1) + 2000 // Needs 15 IDs after this
 };
 
+namespace {
+/// Painting and relayout happen far too often to log every time, so only
+/// ones slow enough to cause visible stutter are logged
+const auto slow_update = std::chrono::milliseconds(8);
+}
+
 BaseGrid::BaseGrid(wxWindow* parent, agi::Context *context)
 : wxWindow(parent, -1, wxDefaultPosition, wxDefaultSize, wxWANTS_CHARS | wxSUNKEN_BORDER)
 , scrollBar(new wxScrollBar(this, GRID_SCROLLBAR, wxDefaultPosition, wxDefaultSize, wxSB_VERTICAL))
@@ -132,7 +140,10 @@ void BaseGrid::OnDPIChanged(wxDPIChangedEvent &e) {
 	e.Skip();
 }
 
-void BaseGrid::OnSubtitlesCommit(int type) {
+void BaseGrid::OnSubtitlesCommit(int type, const AssDialogue *changed) {
+	for (auto const& column : columns)
+		column->OnCommit(context, type, changed);
+
 	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_ORDER || type & AssFile::COMMIT_DIAG_ADDREM)
 		UpdateMaps();
 
@@ -291,6 +302,8 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 
 	if (!any) return;
 
+	auto paint_start = std::chrono::steady_clock::now();
+
 	int w = 0;
 	int h = 0;
 	GetClientSize(&w,&h);
@@ -420,6 +433,11 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 		dc.SetBrush(*wxTRANSPARENT_BRUSH);
 		dc.DrawRectangle(0, (active_line->Row - yPos + 1) * lineHeight, w, lineHeight + 1);
 	}
+
+	using namespace std::chrono;
+	auto elapsed = steady_clock::now() - paint_start;
+	if (elapsed >= slow_update)
+		LOG_D("grid") << "Painted " << nDraw << " rows in " << duration_cast<microseconds>(elapsed).count() << "us";
 }
 
 void BaseGrid::OnSize(wxSizeEvent &) {
@@ -601,6 +619,8 @@ void BaseGrid::AdjustScrollbar() {
 }
 
 void BaseGrid::SetColumnWidths() {
+	auto start = std::chrono::steady_clock::now();
+
 	int w, h;
 	GetClientSize(&w, &h);
 
@@ -622,6 +642,12 @@ void BaseGrid::SetColumnWidths() {
 		x += column->Width();
 	}
 	width_helper->Age();
+
+	using namespace std::chrono;
+	auto elapsed = steady_clock::now() - start;
+	if (elapsed >= slow_update)
+		LOG_D("grid") << "Updated column widths for " << GetRows() << " rows in "
+			<< duration_cast<microseconds>(elapsed).count() << "us";
 }
 
 AssDialogue *BaseGrid::GetDialogue(int n) const {
@@ -94,6 +94,32 @@ class DataBlockCache {
 		age.erase(mb.position);
 	}
 
+	/// @brief Get the slot for a block, marking its macroblock as most recently used
+	/// @param i Index of the block
+	typename BlockFactoryT::BlockType& Touch(size_t i)
+	{
+		size_t mbi = i >> MacroblockExponent;
+		assert(mbi < data.size());
+
+		auto &mb = data[mbi];
+
+		// Move this macroblock to the front of the age list
+		if (mb.blocks.empty())
+		{
+			mb.blocks.resize(macroblock_size);
+			age.push_front(&mb);
+		}
+		else if (mb.position != begin(age))
+			age.splice(begin(age), age, mb.position);
+
+		mb.position = age.begin();
+
+		size_t block_index = i & macroblock_index_mask;
+		assert(block_index < mb.blocks.size());
+
+		return mb.blocks[block_index];
+	}
+
 public:
 	/// @brief Constructor
 	/// @param block_count Total number of blocks the cache will manage
@@ -162,31 +188,13 @@ public:
 	/// It is legal to pass 0 (null) for created, in this case nothing is returned in it.
 	BlockT& Get(size_t i, bool *created = nullptr)
 	{
-		size_t mbi = i >> MacroblockExponent;
-		assert(mbi < data.size());
-
-		auto &mb = data[mbi];
-
-		// Move this macroblock to the front of the age list
-		if (mb.blocks.empty())
-		{
-			mb.blocks.resize(macroblock_size);
-			age.push_front(&mb);
-		}
-		else if (mb.position != begin(age))
-			age.splice(begin(age), age, mb.position);
-
-		mb.position = age.begin();
-
-		size_t block_index = i & macroblock_index_mask;
-		assert(block_index < mb.blocks.size());
-
-		BlockT *b = mb.blocks[block_index].get();
+		auto &block = Touch(i);
+		BlockT *b = block.get();
 
 		if (!b)
 		{
-			mb.blocks[block_index] = factory.ProduceBlock(i);
-			b = mb.blocks[block_index].get();
+			block = factory.ProduceBlock(i);
+			b = block.get();
 			assert(b != nullptr);
 			size += factory.GetBlockSize();
 
@@ -197,4 +205,24 @@ public:
 
 		return *b;
 	}
+
+	/// @brief Obtain a data block from the cache only if it is already there
+	/// @param i Index of the block to retrieve
+	/// @return A pointer to the block in cache, or null if it has not been produced
+	BlockT *TryGet(size_t i)
+	{
+		return Touch(i).get();
+	}
+
+	/// @brief Store a block which was produced elsewhere
+	/// @param i     Index of the block
+	/// @param block The block to store, replacing any existing block with that index
+	void Insert(size_t i, typename BlockFactoryT::BlockType block)
+	{
+		assert(block != nullptr);
+		auto &existing = Touch(i);
+		if (!existing)
+			size += factory.GetBlockSize();
+		existing = std::move(block);
+	}
 };
@@ -27,13 +27,16 @@
 #include "text_selection_controller.h"
 
 #include <libaegisub/ass/dialogue_parser.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/spellchecker.h>
 
+#include <atomic>
 #include <boost/locale/conversion.hpp>
 #include <map>
 #include <memory>
 #include <set>
+#include <unordered_set>
 #include <wx/arrstr.h>
 #include <wx/checkbox.h>
 #include <wx/combobox.h>
@@ -48,7 +51,10 @@
 namespace {
 class DialogSpellChecker final : public wxDialog {
 	agi::Context *context; ///< The project context
-	std::unique_ptr<agi::SpellChecker> spellchecker; ///< The spellchecking engine
+	std::shared_ptr<agi::SpellChecker> spellchecker; ///< The spellchecking engine
+
+	/// Set to stop the background check started by CheckFileInBackground
+	std::shared_ptr<std::atomic<bool>> background_cancelled = std::make_shared<std::atomic<bool>>(false);
 
 	/// Words which the user has indicated should always be corrected
 	std::map<std::string, std::string> auto_replace;
@@ -85,6 +91,10 @@ class DialogSpellChecker final : public wxDialog {
 	/// @return Was a misspelling found?
 	bool CheckLine(AssDialogue *active_line, int start_pos, int *commit_id);
 
+	/// Check every word in the file on a background thread, so that the
+	/// results are already known when FindNext gets to them
+	void CheckFileInBackground();
+
 	/// Set the current word to be corrected
 	void SetWord(std::string const& word);
 	/// Correct the currently selected word
@@ -97,6 +107,7 @@ class DialogSpellChecker final : public wxDialog {
 
 public:
 	DialogSpellChecker(agi::Context *context);
+	~DialogSpellChecker();
 };
 
 DialogSpellChecker::DialogSpellChecker(agi::Context *context)
@@ -223,10 +234,46 @@ DialogSpellChecker::DialogSpellChecker(agi::Context *context)
 	SetSizerAndFit(main_sizer);
 	CenterOnParent();
 
+	CheckFileInBackground();
 	if (FindNext())
 		Show();
 }
 
+DialogSpellChecker::~DialogSpellChecker() {
+	*background_cancelled = true;
+}
+
+void DialogSpellChecker::CheckFileInBackground() {
+	bool skip_comments = OPT_GET("Tool/Spell Checker/Skip Comments")->GetBool();
+	std::vector<std::string> lines;
+	for (auto const& line : context->ass->Events) {
+		if (!line.Comment || !skip_comments)
+			lines.push_back(line.Text);
+	}
+
+	agi::dispatch::Background().Async([spellchecker = spellchecker, cancelled = background_cancelled, lines = std::move(lines)]() mutable {
+		std::unordered_set<std::string_view> seen;
+		for (auto const& text : lines) {
+			if (*cancelled) break;
+
+			auto tokens = agi::ass::TokenizeDialogueBody(text);
+			agi::ass::SplitWords(text, tokens);
+
+			size_t pos = 0;
+			for (auto const& tok : tokens) {
+				auto word = std::string_view(text).substr(pos, tok.length);
+				if (tok.type == agi::ass::DialogueTokenType::WORD && seen.insert(word).second)
+					spellchecker->CheckWord(word);
+				pos += tok.length;
+			}
+		}
+
+		// The spell checker listens to option changes, so make sure it's
+		// destroyed on the main thread if the dialog has already closed
+		agi::dispatch::Main().Async([spellchecker = std::move(spellchecker)] { });
+	});
+}
+
 void DialogSpellChecker::OnReplace(wxCommandEvent&) {
 	Replace();
 	FindNext();
@@ -42,6 +42,7 @@
 
 #include <libaegisub/address_of_adaptor.h>
 #include <libaegisub/ass/time.h>
+#include <libaegisub/dispatch.h>
 
 #include <algorithm>
 #include <boost/range/adaptor/filtered.hpp>
@@ -388,18 +389,40 @@ void DialogTimingProcessor::Process() {
 	if (sorted.empty()) return;
 
 	// Add lead-in/out
+	// Each pass works out the new times of all of the lines at once and then
+	// applies them. Lead-out only looks at later lines, which it hasn't
+	// changed yet. Lead-in looks at the earlier lines, but CollidesWith() only
+	// compares against their end times as long as they start no later than
+	// the current line, which moving their start earlier can't change. A
+	// negative lead-in can, so that has to go one line at a time.
 	if (hasLeadIn->IsChecked() && leadIn) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->Start = safe_time(sorted.rend() - i, sorted.rend(),
+		auto lead_in = [&](size_t i) {
+			return safe_time(sorted.rend() - i, sorted.rend(),
 				sorted[i], sorted[i]->Start - leadIn,
 				&AssDialogue::End, &std::max<int>);
+		};
+
+		if (leadIn > 0) {
+			std::vector<int> start(sorted.size());
+			agi::dispatch::ParallelFor(sorted.size(), [&](size_t i) { start[i] = lead_in(i); });
+			for (size_t i = 0; i < sorted.size(); ++i)
+				sorted[i]->Start = start[i];
+		}
+		else {
+			for (size_t i = 0; i < sorted.size(); ++i)
+				sorted[i]->Start = lead_in(i);
+		}
 	}
 
 	if (hasLeadOut->IsChecked() && leadOut) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->End = safe_time(sorted.begin() + i + 1, sorted.end(),
+		std::vector<int> end(sorted.size());
+		agi::dispatch::ParallelFor(sorted.size(), [&](size_t i) {
+			end[i] = safe_time(sorted.begin() + i + 1, sorted.end(),
 				sorted[i], sorted[i]->End + leadOut,
 				&AssDialogue::Start, &std::min<int>);
+		});
+		for (size_t i = 0; i < sorted.size(); ++i)
+			sorted[i]->End = end[i];
 	}
 
 	// Make adjacent
@@ -426,7 +449,10 @@ void DialogTimingProcessor::Process() {
 		if (auto provider = c->project->VideoProvider())
 			kf.push_back(provider->GetFrameCount() - 1);
 
-		for (AssDialogue *cur : sorted) {
+		// Each line only depends on its own times
+		agi::dispatch::ParallelFor(sorted.size(), [&](size_t i) {
+			AssDialogue *cur = sorted[i];
+
 			// Get start/end frames
 			int startF = fps.FrameAtTime(cur->Start, agi::vfr::START);
 			int endF = fps.FrameAtTime(cur->End, agi::vfr::END);
@@ -442,7 +468,7 @@ void DialogTimingProcessor::Process() {
 			time = fps.TimeAtFrame(closest, agi::vfr::END);
 			if ((closest > endF && time - cur->End <= beforeEnd) || (closest < endF && cur->End - time <= afterEnd))
 				cur->End = time;
-		}
+		});
 	}
 
 	c->ass->Commit(_("timing processor"), AssFile::COMMIT_DIAG_TIME);
@@ -22,6 +22,7 @@
 #include "compat.h"
 #include "format.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/format_flyweight.h>
 #include <libaegisub/format_path.h>
 
@@ -59,13 +60,35 @@ FontCollector::FontCollector(FontCollectorStatusCallback status_callback)
 {
 }
 
-void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
+void FontCollector::CodepointSet::merge(CodepointSet const& other) {
+	for (auto const& page : other.pages)
+		pages[page.first] |= page.second;
+}
+
+std::vector<int> FontCollector::CodepointSet::to_vector() const {
+	std::vector<int> page_indices;
+	page_indices.reserve(pages.size());
+	for (auto const& page : pages)
+		page_indices.push_back(page.first);
+	std::sort(begin(page_indices), end(page_indices));
+
+	std::vector<int> ret;
+	for (int index : page_indices) {
+		auto const& bits = pages.at(index);
+		for (int i = 0; i < 256; ++i) {
+			if (bits[i])
+				ret.push_back(index * 256 + i);
+		}
+	}
+	return ret;
+}
+
+void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index, AssTagTree &tree, LineUsage &usage) const {
 	if (line->Comment) return;
 
 	auto style_it = styles.find(line->Style);
 	if (style_it == end(styles)) {
-		status_callback(fmt_tl("Style '%s' does not exist\n", line->Style), 2);
-		++missing;
+		usage.missing_styles.push_back(line->Style);
 		return;
 	}
 
@@ -74,25 +97,29 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 
 	bool overriden = false;
 
-	for (auto& block : line->ParseTags()) {
-		switch (block->GetType()) {
+	line->ParseTags(tree);
+	for (auto const& block : tree.Blocks()) {
+		switch (block.type) {
 		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
-				if (tag.Name == "\\r") {
-					style = styles[tag.Params[0].Get(line->Style.get())];
+			for (auto const& tag : tree.Tags(block)) {
+				if (!tag.valid) continue;
+				auto const& param = tree.Params(tag)[0];
+				if (tag.name == "\\r") {
+					auto reset_it = styles.find(param.Get(line->Style.get()));
+					style = reset_it == end(styles) ? StyleInfo{} : reset_it->second;
 					reset = style;
 					overriden = false;
 				}
-				else if (tag.Name == "\\b") {
-					style.bold = tag.Params[0].Get(reset.bold);
+				else if (tag.name == "\\b") {
+					style.bold = param.Get(reset.bold);
 					overriden = true;
 				}
-				else if (tag.Name == "\\i") {
-					style.italic = tag.Params[0].Get(reset.italic);
+				else if (tag.name == "\\i") {
+					style.italic = param.Get(reset.italic);
 					overriden = true;
 				}
-				else if (tag.Name == "\\fn") {
-					style.facename = tag.Params[0].Get(reset.facename);
+				else if (tag.name == "\\fn") {
+					style.facename = param.Get(reset.facename);
 					if (style.facename == "0")
 						style.facename = reset.facename;
 					overriden = true;
@@ -100,20 +127,20 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 			}
 			break;
 		case AssBlockType::PLAIN: {
-			auto text = block->GetText();
+			auto text = block.text;
 
 			if (text.empty())
 				continue;
 
-			auto& usage = used_styles[style];
+			auto& style_usage = usage.used_styles[style];
 
 			if (overriden) {
-				auto& lines = usage.lines;
+				auto& lines = style_usage.lines;
 				if (lines.empty() || lines.back() != index)
 					lines.push_back(index);
 			}
 
-			auto& chars = usage.chars;
+			auto& chars = style_usage.chars;
 			auto size = static_cast<int>(text.size());
 			for (int i = 0; i < size; ) {
 				if (text[i] == '\\' && i + 1 < size) {
@@ -124,25 +151,22 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 					}
 					if (next == 'h') {
 						++i;
-						chars.push_back(0xA0);
+						chars.insert(0xA0);
 						continue;
 					}
 
-					chars.push_back('\\');
+					chars.insert('\\');
 					continue;
 				}
 
 				UChar32 c;
 				U8_NEXT(&text[0], i, size, c);
-				chars.push_back(c);
+				chars.insert(c);
 			}
-
-			sort(begin(chars), end(chars));
-			chars.erase(unique(chars.begin(), chars.end()), chars.end());
 			break;
 		}
 		case AssBlockType::DRAWING:
-			used_styles[style].drawing = true;
+			usage.used_styles[style].drawing = true;
 			break;
 		case AssBlockType::COMMENT:
 			break;
@@ -150,15 +174,11 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 	}
 }
 
-void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
-	if (style.second.chars.empty() && !style.second.drawing) return;
-
+void FontCollector::ProcessChunk(std::pair<const StyleInfo, UsageData> const& style, CollectionResult& res) {
 	if (style.second.chars.empty() && style.second.drawing) {
 		status_callback(fmt_tl("Font '%s' is used in a drawing, but not in any text.\n", style.first.facename), 3);
 	}
 
-	auto res = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars);
-
 	if (res.paths.empty()) {
 		status_callback(fmt_tl("Could not find font '%s'\n", style.first.facename), 2);
 		PrintUsage(style.second);
@@ -223,12 +243,58 @@ std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
 		used_styles[info].styles.push_back(style.name);
 	}
 
-	int index = 0;
+	// Scan blocks of lines in parallel and then merge the results in order
+	std::vector<const AssDialogue *> lines;
+	lines.reserve(file->Events.size());
 	for (auto const& diag : file->Events)
-		ProcessDialogueLine(&diag, ++index);
+		lines.push_back(&diag);
+
+	constexpr size_t block_size = 256;
+	std::vector<LineUsage> blocks((lines.size() + block_size - 1) / block_size);
+	agi::dispatch::ParallelFor(blocks.size(), [&](size_t i) {
+		AssTagTree tree;
+		size_t end = std::min(lines.size(), (i + 1) * block_size);
+		for (size_t j = i * block_size; j < end; ++j)
+			ProcessDialogueLine(lines[j], static_cast<int>(j + 1), tree, blocks[i]);
+	});
+
+	for (auto& block : blocks) {
+		for (auto const& style : block.missing_styles) {
+			status_callback(fmt_tl("Style '%s' does not exist\n", style), 2);
+			++missing;
+		}
+
+		for (auto& style : block.used_styles) {
+			auto& usage = used_styles[style.first];
+			usage.chars.merge(style.second.chars);
+			usage.drawing = usage.drawing || style.second.drawing;
+			usage.lines.insert(usage.lines.end(), style.second.lines.begin(), style.second.lines.end());
+		}
+	}
 
 	status_callback(_("Searching for font files\n"), 0);
-	for (auto const& style : used_styles) ProcessChunk(style);
+	std::vector<std::pair<const StyleInfo, UsageData> const*> to_find;
+	for (auto const& style : used_styles) {
+		if (!style.second.chars.empty() || style.second.drawing)
+			to_find.push_back(&style);
+	}
+
+	// Look up all of the fonts first, in parallel if the lister allows it,
+	// and then report the results in order
+	std::vector<CollectionResult> found(to_find.size());
+	auto find = [&](size_t i) {
+		auto const& style = *to_find[i];
+		found[i] = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars.to_vector());
+	};
+	if constexpr (FontFileLister::thread_safe)
+		agi::dispatch::ParallelFor(to_find.size(), find);
+	else {
+		for (size_t i = 0; i < to_find.size(); ++i)
+			find(i);
+	}
+
+	for (size_t i = 0; i < to_find.size(); ++i)
+		ProcessChunk(*to_find[i], found[i]);
 	status_callback(_("Done\n\n"), 0);
 
 	std::vector<agi::fs::path> paths;
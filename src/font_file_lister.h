@@ -17,8 +17,10 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/scoped_ptr.h>
 
+#include <bitset>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -27,6 +29,7 @@
 
 class AssDialogue;
 class AssFile;
+class AssTagTree;
 
 typedef std::function<void (wxString, int)> FontCollectorStatusCallback;
 
@@ -48,6 +51,9 @@ class GdiFontFileLister {
 	agi::scoped_holder<IDWriteGdiInterop*> gdi_interop_sh;
 
 public:
+	/// GetFontPaths uses a single DC, so it can't be called concurrently
+	static constexpr bool thread_safe = false;
+
 	/// Constructor
 	/// @throws agi::EnvironmentError if an error occurs during construction.
 	GdiFontFileLister(FontCollectorStatusCallback &);
@@ -66,6 +72,8 @@ using FontFileLister = GdiFontFileLister;
 #elif defined(__APPLE__)
 
 struct CoreTextFontFileLister {
+	static constexpr bool thread_safe = false;
+
 	CoreTextFontFileLister(FontCollectorStatusCallback &) {}
 
 	/// @brief Get the path to the font with the given styles
@@ -81,21 +89,19 @@ using FontFileLister = CoreTextFontFileLister;
 
 #else
 
-typedef struct _FcConfig FcConfig;
-typedef struct _FcFontSet FcFontSet;
-
 /// @class FontConfigFontFileLister
 /// @brief fontconfig powered font lister
 class FontConfigFontFileLister {
-	agi::scoped_holder<FcConfig*> config;
-
-	/// @brief Case-insensitive match ASS/SSA font family against full name. (also known as "name for humans")
-	/// @param family font fullname
-	/// @param bold weight attribute
-	/// @param italic italic attribute
-	/// @return font set
-	FcFontSet *MatchFullname(const char *family, int weight, int slant);
+	/// The loaded fontconfig configuration and an index of its fonts by name
+	struct FontIndex;
+	std::shared_ptr<const FontIndex> index;
+
+	/// Get the index for the current configuration, which is reused by each
+	/// lister until fontconfig reports that the fonts have changed
+	static std::shared_ptr<const FontIndex> GetIndex(FontCollectorStatusCallback &cb);
 public:
+	static constexpr bool thread_safe = true;
+
 	/// Constructor
 	/// @param cb Callback for status logging
 	FontConfigFontFileLister(FontCollectorStatusCallback &cb);
@@ -123,14 +129,33 @@ class FontCollector {
 		bool operator<(StyleInfo const& rgt) const;
 	};
 
+	/// Set of codepoints, stored as a bitmap for each 256-codepoint page
+	/// which has any of them
+	class CodepointSet {
+		std::unordered_map<int, std::bitset<256>> pages;
+	public:
+		void insert(int c) { pages[c >> 8].set(c & 0xFF); }
+		void merge(CodepointSet const& other);
+		bool empty() const { return pages.empty(); }
+		/// Get the codepoints in ascending order
+		std::vector<int> to_vector() const;
+	};
+
 	/// Data about where each style is used
 	struct UsageData {
-		std::vector<int> chars;          ///< Characters used in this style which glyphs will be needed for
+		CodepointSet chars;              ///< Characters used in this style which glyphs will be needed for
 		bool drawing = false;            ///< Whether this style is used for a drawing
 		std::vector<int> lines;          ///< Lines on which this style is used via overrides
 		std::vector<std::string> styles; ///< ASS styles which use this style
 	};
 
+	/// Styles used by a range of lines
+	struct LineUsage {
+		std::map<StyleInfo, UsageData> used_styles;
+		/// Names of the nonexistent styles used, in line order
+		std::vector<std::string> missing_styles;
+	};
+
 	/// Message callback provider by caller
 	FontCollectorStatusCallback status_callback;
 
@@ -148,10 +173,12 @@ class FontCollector {
 	int missing_glyphs = 0;
 
 	/// Gather all of the unique styles with text on a line
-	void ProcessDialogueLine(const AssDialogue *line, int index);
+	/// @param tree Scratch space for parsing the line
+	/// @param usage Usage to add the line's to
+	void ProcessDialogueLine(const AssDialogue *line, int index, AssTagTree &tree, LineUsage &usage) const;
 
-	/// Get the font for a single style
-	void ProcessChunk(std::pair<StyleInfo, UsageData> const& style);
+	/// Report the font found for a single style
+	void ProcessChunk(std::pair<const StyleInfo, UsageData> const& style, CollectionResult& res);
 
 	/// Print the lines and styles on which a missing font is used
 	void PrintUsage(UsageData const& data);
@@ -21,39 +21,60 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <fontconfig/fontconfig.h>
+#include <mutex>
+#include <unordered_map>
 #include <wx/intl.h>
 
-namespace {
-bool pattern_matches(FcPattern *pat, const char *field, std::string const& name) {
-	FcChar8 *str;
-	for (int i = 0; FcPatternGetString(pat, field, i, &str) == FcResultMatch; ++i) {
-		std::string sstr((char *)str);
-		boost::to_lower(sstr);
-		if (sstr == name)
-			return true;
+struct FontConfigFontFileLister::FontIndex {
+	agi::scoped_holder<FcConfig*> config{FcInitLoadConfig(), FcConfigDestroy};
+
+	/// Lowercased family and full names -> outline fonts with that name, in
+	/// the order fontconfig lists them. The patterns are owned by config.
+	std::unordered_map<std::string, std::vector<FcPattern *>> fonts;
+
+	void Add(FcFontSet *src) {
+		if (!src) return;
+
+		for (FcPattern *pat : boost::make_iterator_range(&src->fonts[0], &src->fonts[src->nfont])) {
+			int val;
+			if (FcPatternGetBool(pat, FC_OUTLINE, 0, &val) != FcResultMatch || val != FcTrue) continue;
+
+			for (const char *field : {FC_FULLNAME, FC_FAMILY}) {
+				FcChar8 *str;
+				for (int i = 0; FcPatternGetString(pat, field, i, &str) == FcResultMatch; ++i) {
+					std::string name((char *)str);
+					boost::to_lower(name);
+					auto& matches = fonts[name];
+					if (matches.empty() || matches.back() != pat)
+						matches.push_back(pat);
+				}
+			}
+		}
 	}
-	return false;
-}
-
-void find_font(FcFontSet *src, FcFontSet *dst, std::string const& family) {
-	if (!src) return;
+};
 
-	for (FcPattern *pat : boost::make_iterator_range(&src->fonts[0], &src->fonts[src->nfont])) {
-		int val;
-		if (FcPatternGetBool(pat, FC_OUTLINE, 0, &val) != FcResultMatch || val != FcTrue) continue;
+std::shared_ptr<const FontConfigFontFileLister::FontIndex> FontConfigFontFileLister::GetIndex(FontCollectorStatusCallback &cb) {
+	static std::mutex lock;
+	static std::shared_ptr<const FontIndex> cached;
 
-		if (pattern_matches(pat, FC_FULLNAME, family) || pattern_matches(pat, FC_FAMILY, family))
-			FcFontSetAdd(dst, FcPatternDuplicate(pat));
-	}
-}
+	std::lock_guard<std::mutex> guard(lock);
+	if (cached && FcConfigUptoDate(cached->config))
+		return cached;
 
+	cb(_("Updating font cache\n"), 0);
+	auto index = std::make_shared<FontIndex>();
+	FcConfigBuildFonts(index->config);
+	index->Add(FcConfigGetFonts(index->config, FcSetApplication));
+	index->Add(FcConfigGetFonts(index->config, FcSetSystem));
+	LOG_D("font_collector/fontconfig") << "indexed " << index->fonts.size() << " font names";
+
+	cached = index;
+	return index;
 }
 
 FontConfigFontFileLister::FontConfigFontFileLister(FontCollectorStatusCallback &cb)
-: config(FcInitLoadConfig(), FcConfigDestroy)
+: index(GetIndex(cb))
 {
-	cb(_("Updating font cache\n"), 0);
-	FcConfigBuildFonts(config);
 }
 
 CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facename, int bold, bool italic, std::vector<int> const& characters) {
@@ -62,6 +83,16 @@ CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facen
 	std::string family = facename[0] == '@' ? facename.substr(1) : facename;
 	boost::to_lower(family);
 
+	// Only correctly named fonts are considered, as the patterns returned by
+	// font matching only include the first family and fullname, so we can't
+	// always verify that we got the actual font we were asking for after the
+	// fact
+	auto named = index->fonts.find(family);
+	if (named == index->fonts.end())
+		return ret;
+
+	FcConfig *config = index->config;
+
 	int weight = bold == 0 ? 400 :
 	             bold == 1 ? 700 :
 	                         bold;
@@ -78,13 +109,9 @@ CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facen
 	FcDefaultSubstitute(pat);
 	if (!FcConfigSubstitute(config, pat, FcMatchPattern)) return ret;
 
-	// Create a font set with only correctly named fonts
-	// This is needed because the patterns returned by font matching only
-	// include the first family and fullname, so we can't always verify that
-	// we got the actual font we were asking for after the fact
 	agi::scoped_holder<FcFontSet*> fset(FcFontSetCreate(), FcFontSetDestroy);
-	find_font(FcConfigGetFonts(config, FcSetApplication), fset, family);
-	find_font(FcConfigGetFonts(config, FcSetSystem), fset, family);
+	for (FcPattern *font : named->second)
+		FcFontSetAdd(fset, FcPatternDuplicate(font));
 
 	// Get the best match from fontconfig
 	FcResult result;
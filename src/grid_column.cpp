@@ -25,6 +25,8 @@
 
 #include <libaegisub/character_count.h>
 
+#include <functional>
+#include <map>
 #include <wx/dc.h>
 
 void WidthHelper::Age() {
@@ -117,6 +119,68 @@ struct GridColumnLineNumber final : GridColumn {
 	}
 };
 
+/// Number of lines with each value of some property of the lines, which is
+/// kept up to date as lines are changed rather than recounted every time the
+/// column widths are needed
+template<typename T>
+class LineValueCounts {
+	std::function<T (AssDialogue const&)> get;
+	/// Value for each row as of the last update
+	mutable std::vector<T> rows;
+	mutable std::map<T, size_t> counts;
+	mutable bool valid = false;
+
+	void Set(size_t row, T const& value) {
+		if (rows[row] == value) return;
+		auto it = counts.find(rows[row]);
+		if (--it->second == 0)
+			counts.erase(it);
+		++counts[value];
+		rows[row] = value;
+	}
+
+public:
+	LineValueCounts(std::function<T (AssDialogue const&)> get) : get(std::move(get)) { }
+
+	void OnCommit(EntryList<AssDialogue> const& lines, int type, const AssDialogue *changed) {
+		if (type == AssFile::COMMIT_NEW || type & (AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM)) {
+			valid = false;
+			return;
+		}
+		if (!valid || !(type & AssFile::COMMIT_DIAG_META)) return;
+
+		if (changed && static_cast<size_t>(changed->Row) < rows.size()) {
+			Set(changed->Row, get(*changed));
+			return;
+		}
+
+		size_t row = 0;
+		for (auto const& line : lines) {
+			if (row == rows.size()) {
+				valid = false;
+				return;
+			}
+			Set(row++, get(line));
+		}
+		if (row != rows.size())
+			valid = false;
+	}
+
+	/// Get each distinct value and the number of lines with it
+	std::map<T, size_t> const& Get(EntryList<AssDialogue> const& lines) const {
+		if (!valid) {
+			rows.clear();
+			counts.clear();
+			for (auto const& line : lines) {
+				rows.push_back(get(line));
+				++counts[rows.back()];
+			}
+			valid = true;
+		}
+		return counts;
+	}
+};
+
 template<typename T>
 T max_value(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines) {
 	T value = 0;
@@ -132,14 +196,21 @@ struct GridColumnLayer final : GridColumn {
 	COLUMN_DESCRIPTION(_("Layer"))
 	bool Centered() const override { return true; }
 
+	LineValueCounts<int> layers{[](AssDialogue const& d) { return d.Layer; }};
+
 	wxString Value(const AssDialogue *d, const agi::Context *) const override {
 		return d->Layer ? wxString(std::to_wstring(d->Layer)) : wxString();
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max_layer = max_value(&AssDialogue::Layer, c->ass->Events);
+		auto const& counts = layers.Get(c->ass->Events);
+		int max_layer = counts.empty() ? 0 : std::max(0, counts.rbegin()->first);
 		return max_layer == 0 ? 0 : helper(std::to_wstring(max_layer));
 	}
+
+	void OnCommit(const agi::Context *c, int type, const AssDialogue *changed) override {
+		layers.OnCommit(c->ass->Events, type, changed);
+	}
 };
 
 struct GridColumnTime : GridColumn {
@@ -185,64 +256,65 @@ struct GridColumnEndTime final : GridColumnTime {
 	}
 };
 
-template<typename T>
-int max_width(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines, WidthHelper &helper) {
-	int w = 0;
-	for (AssDialogue const& line : lines) {
-		auto const& v = line.*field;
-		if (v.get().empty()) continue;
-		int width = helper(v);
-		if (width > w)
-			w = width;
+/// Column which displays one of the string metadata fields of the lines
+struct GridColumnStringField : GridColumn {
+	boost::flyweight<std::string> AssDialogueBase::*field;
+	LineValueCounts<boost::flyweight<std::string>> values;
+
+	GridColumnStringField(boost::flyweight<std::string> AssDialogueBase::*field)
+	: field(field)
+	, values([=](AssDialogue const& d) { return d.*field; })
+	{
 	}
-	return w;
-}
 
-struct GridColumnStyle final : GridColumn {
-	COLUMN_HEADER(_("Style"))
-	COLUMN_DESCRIPTION(_("Style"))
 	bool Centered() const override { return false; }
 
 	wxString Value(const AssDialogue *d, const agi::Context *) const override {
-		return to_wx(d->Style);
+		return to_wx(d->*field);
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Style, c->ass->Events, helper);
+		// Only each distinct value needs to be measured
+		int w = 0;
+		for (auto const& value : values.Get(c->ass->Events)) {
+			if (!value.first.get().empty())
+				w = std::max(w, helper(value.first));
+		}
+		return w;
+	}
+
+	void OnCommit(const agi::Context *c, int type, const AssDialogue *changed) override {
+		values.OnCommit(c->ass->Events, type, changed);
 	}
 };
 
-struct GridColumnEffect final : GridColumn {
+struct GridColumnStyle final : GridColumnStringField {
+	GridColumnStyle() : GridColumnStringField(&AssDialogue::Style) { }
+	COLUMN_HEADER(_("Style"))
+	COLUMN_DESCRIPTION(_("Style"))
+};
+
+struct GridColumnEffect final : GridColumnStringField {
+	GridColumnEffect() : GridColumnStringField(&AssDialogue::Effect) { }
 	COLUMN_HEADER(_("Effect"))
 	COLUMN_DESCRIPTION(_("Effect"))
-	bool Centered() const override { return false; }
-
-	wxString Value(const AssDialogue *d, const agi::Context *) const override {
-		return to_wx(d->Effect);
-	}
-
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Effect, c->ass->Events, helper);
-	}
 };
 
-struct GridColumnActor final : GridColumn {
+struct GridColumnActor final : GridColumnStringField {
+	GridColumnActor() : GridColumnStringField(&AssDialogue::Actor) { }
 	COLUMN_HEADER(_("Actor"))
 	COLUMN_DESCRIPTION(_("Actor"))
-	bool Centered() const override { return false; }
-
-	wxString Value(const AssDialogue *d, const agi::Context *) const override {
-		return to_wx(d->Actor);
-	}
-
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Actor, c->ass->Events, helper);
-	}
 };
 
 struct GridColumnMargin : GridColumn {
 	int index;
-	GridColumnMargin(int index) : index(index) { }
+	LineValueCounts<int> margins;
+
+	GridColumnMargin(int index)
+	: index(index)
+	, margins([=](AssDialogue const& d) { return d.Margin[index]; })
+	{
+	}
 
 	bool Centered() const override { return true; }
 
@@ -251,13 +323,14 @@ struct GridColumnMargin : GridColumn {
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max = 0;
-		for (AssDialogue const& line : c->ass->Events) {
-			if (line.Margin[index] > max)
-				max = line.Margin[index];
-		}
+		auto const& counts = margins.Get(c->ass->Events);
+		int max = counts.empty() ? 0 : std::max(0, counts.rbegin()->first);
 		return max == 0 ? 0 : helper(std::to_wstring(max));
 	}
+
+	void OnCommit(const agi::Context *c, int type, const AssDialogue *changed) override {
+		margins.OnCommit(c->ass->Events, type, changed);
+	}
 };
 
 struct GridColumnMarginLeft final : GridColumnMargin {
@@ -292,6 +365,11 @@ class GridColumnCPS final : public GridColumn {
 	const agi::OptionValue *cps_error = OPT_GET("Subtitle/Character Counter/CPS Error Threshold");
 	const agi::OptionValue *bg_color = OPT_GET("Colour/Subtitle Grid/CPS Error");
 
+	/// CPS of the lines which have been painted since they last changed
+	mutable std::unordered_map<const AssDialogue *, int> cps_cache;
+	/// Character counting flags which the cached values were calculated with
+	mutable int cache_ignore = -1;
+
 public:
 	COLUMN_HEADER(_("CPS"))
 	COLUMN_DESCRIPTION(_("Characters Per Second"))
@@ -315,7 +393,31 @@ public:
 		if (ignore_punctuation->GetBool())
 			ignore |= agi::IGNORE_PUNCTUATION;
 
-		return agi::CharacterCount(text, ignore) * 1000 / duration;
+		if (ignore != cache_ignore) {
+			cps_cache.clear();
+			cache_ignore = ignore;
+		}
+
+		auto it = cps_cache.find(d);
+		if (it != cps_cache.end())
+			return it->second;
+
+		int cps = agi::CharacterCount(text, ignore) * 1000 / duration;
+		cps_cache[d] = cps;
+		return cps;
+	}
+
+	void OnCommit(const agi::Context *, int type, const AssDialogue *changed) override {
+		// Lines can be deleted and reallocated at the same address, so any
+		// change to the set of lines has to discard everything
+		if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_DIAG_ADDREM)
+			cps_cache.clear();
+		else if (type & (AssFile::COMMIT_DIAG_TIME | AssFile::COMMIT_DIAG_TEXT)) {
+			if (changed)
+				cps_cache.erase(changed);
+			else
+				cps_cache.clear();
+		}
 	}
 
 	int Width(const agi::Context *, WidthHelper &helper) const override {
@@ -74,6 +74,11 @@ public:
 
 	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper);
 	virtual void SetByFrame(bool /* by_frame */) { }
+
+	/// Update anything cached about the lines after a commit
+	/// @param type    AssFile::CommitType flags for the commit
+	/// @param changed Line which was changed, if only one line was
+	virtual void OnCommit(const agi::Context * /* c */, int /* type */, const AssDialogue * /* changed */) { }
 	void SetVisible(bool new_value) { visible = new_value; }
 };
 
@@ -21,6 +21,7 @@
 #include "compat.h"
 #include "options.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/path.h>
 
 #include <boost/range/algorithm/find.hpp>
@@ -123,7 +124,11 @@ void init() {
 	}
 #endif
 
-	OPT_SET("App/Hotkey Migrations")->SetListString(std::move(migrations));
+	// This is run on a background thread during startup, so the option is
+	// updated on the main thread rather than here
+	agi::dispatch::Main().Async([migrations = std::move(migrations)]() mutable {
+		OPT_SET("App/Hotkey Migrations")->SetListString(std::move(migrations));
+	});
 }
 
 void clear() {
@@ -38,6 +38,7 @@
 #include <string>
 #include <vector>
 
+class AssDialogue;
 class AssFile;
 struct VideoFrame;
 
@@ -48,7 +49,26 @@ class SubtitlesProvider {
 public:
 	virtual ~SubtitlesProvider() = default;
 	void LoadSubtitles(AssFile *subs, int time = -1);
+
+	/// @brief Bring the loaded subtitles up to date after a commit
+	/// @param subs    File to load
+	/// @param type    AssFile::CommitType flags for all changes made since the last load
+	/// @param changed Line which was changed, if only one line was
+	/// @return false if this provider does not support incremental updates, in
+	///         which case nothing has been loaded and the caller should use
+	///         LoadSubtitles instead
+	virtual bool UpdateSubtitles([[maybe_unused]] AssFile *subs, [[maybe_unused]] int type, [[maybe_unused]] const AssDialogue *changed) { return false; }
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
+
+	/// @brief Draw the subtitles onto a transparent frame
+	/// @param dst  Frame to draw on, which must be fully transparent black
+	/// @param time Time in seconds to draw the subtitles at
+	///
+	/// The result is premultiplied BGRA which gives the same result as
+	/// DrawSubtitles when composited over a frame. The default implementation
+	/// draws the subtitles twice to work out the alpha; providers which can
+	/// produce it directly should override this.
+	virtual void DrawOverlay(VideoFrame &dst, double time);
 	virtual void Reinitialize() { }
 };
 
@@ -38,9 +38,11 @@
 #include <libaegisub/vfr.h>
 #include <libaegisub/ycbcr.h>
 
+#include <memory>
 #include <string>
 
 struct VideoFrame;
+class VideoFramePool;
 
 class VideoProvider {
 public:
@@ -49,6 +51,22 @@ public:
 	/// Override this method to actually get frames
 	virtual void GetFrame(int n, VideoFrame &frame)=0;
 
+	/// @brief Get a frame which may be shared with other users
+	/// @param n    Frame number
+	/// @param pool Pool to take the frame's buffer from if a new one is needed
+	///
+	/// The frame must not be modified. By default this decodes into a frame
+	/// from the pool, while caching providers return the cached frame itself.
+	virtual std::shared_ptr<const VideoFrame> GetSharedFrame(int n, VideoFramePool &pool);
+
+	/// @brief Decode a frame into the provider's frame cache before it's requested
+	/// @param n        Frame number
+	/// @param distance Number of frames being read ahead of the one last requested, including this one
+	/// @param pool     Pool to take the frame's buffer from
+	/// @return Whether the frame is now cached. If not, frames further ahead
+	///         won't be either.
+	virtual bool PrefetchFrame([[maybe_unused]] int n, [[maybe_unused]] int distance, [[maybe_unused]] VideoFramePool &pool) { return false; }
+
 	/// Set the YCbCr matrix to the specified one
 	///
 	/// Providers are free to disregard this, and should if the requested
@@ -50,6 +50,7 @@
 #include "libresrc/libresrc.h"
 #include "options.h"
 #include "project.h"
+#include "startup.h"
 #include "subs_controller.h"
 #include "subtitles_provider_libass.h"
 #include "utils.h"
@@ -80,12 +81,10 @@ namespace config {
 
 wxIMPLEMENT_APP(AegisubApp);
 
-static const char *LastStartupState = nullptr;
-
 #ifdef WITH_STARTUPLOG
-#define StartupLog(a) MessageBox(0, L ## a, L"Aegisub startup log", 0)
+#define StartupLog(a) (MessageBox(0, L ## a, L"Aegisub startup log", 0), startup::Phase(a))
 #else
-#define StartupLog(a) LastStartupState = a
+#define StartupLog(a) startup::Phase(a)
 #endif
 
 void AegisubApp::OnAssertFailure(const wxChar *file, int line, const wxChar *func, const wxChar *cond, const wxChar *msg) {
@@ -214,104 +213,139 @@ bool AegisubApp::OnInit() {
 	}
 #endif
 
-	// Init commands.
-	cmd::init_builtin_commands();
-
-	// Init hotkeys
-	hotkey::init();
-
-	StartupLog("Load MRU");
-	config::mru = new agi::MRUManager(config::path->Decode("?user/mru.json"), GET_DEFAULT_CONFIG(default_mru), config::opt);
-
 	agi::util::SetThreadName("AegiMain");
 
 	StartupLog("Inside OnInit");
 	try {
-		// Initialize randomizer
-		StartupLog("Initialize random generator");
-		srand(time(nullptr));
+		using When = startup::Scheduler::When;
+		startup::Scheduler init;
+
+		init.Add("Register commands", When::Now, {}, [] {
+			cmd::init_builtin_commands();
+		});
+
+		init.Add("Initialize random generator", When::Now, {}, [] {
+			srand(time(nullptr));
+		});
 
 		// locale for loading options
-		StartupLog("Set initial locale");
-		setlocale(LC_NUMERIC, "C");
-		setlocale(LC_CTYPE, "C");
+		init.Add("Set initial locale", When::Now, {}, [] {
+			setlocale(LC_NUMERIC, "C");
+			setlocale(LC_CTYPE, "C");
+		});
 
 		// Crash handling
 #if (!defined(_DEBUG) || defined(WITH_EXCEPTIONS)) && (wxUSE_ON_FATAL_EXCEPTION+0)
-		StartupLog("Install exception handler");
-		wxHandleFatalExceptions(true);
+		init.Add("Install exception handler", When::Now, {}, [] {
+			wxHandleFatalExceptions(true);
+		});
 #endif
 
-		StartupLog("Store options back");
-		OPT_SET("Version/Last Version")->SetInt(GetSVNRevision());
-
-		StartupLog("Initialize final locale");
+		init.Add("Store options back", When::Now, {}, [] {
+			OPT_SET("Version/Last Version")->SetInt(GetSVNRevision());
+		});
 
-		// Set locale
-		auto lang = OPT_GET("App/Language")->GetString();
-		if (lang.empty() || (lang != "en_US" && !locale.HasLanguage(lang))) {
-			lang = locale.PickLanguage();
-			OPT_SET("App/Language")->SetString(lang);
-		}
-		locale.Init(lang);
+		init.Add("Initialize final locale", When::Now, {"Set initial locale"}, [this] {
+			auto lang = OPT_GET("App/Language")->GetString();
+			if (lang.empty() || (lang != "en_US" && !locale.HasLanguage(lang))) {
+				lang = locale.PickLanguage();
+				OPT_SET("App/Language")->SetString(lang);
+			}
+			locale.Init(lang);
 
 #ifdef __APPLE__
-		// When run from an app bundle, LC_CTYPE defaults to "C", which breaks on
-		// anything involving unicode and in some cases number formatting.
-		// The right thing to do here would be to query CoreFoundation for the user's
-		// locale and add .UTF-8 to that, but :effort:
-		setlocale(LC_CTYPE, "en_US.UTF-8");
+			// When run from an app bundle, LC_CTYPE defaults to "C", which breaks on
+			// anything involving unicode and in some cases number formatting.
+			// The right thing to do here would be to query CoreFoundation for the user's
+			// locale and add .UTF-8 to that, but :effort:
+			setlocale(LC_CTYPE, "en_US.UTF-8");
 #endif
 
-		exception_message = _("Oops, Aegisub has crashed!\n\nAn attempt has been made to save a copy of your file to:\n\n%s\n\nAegisub will now close.");
-
-		agi::xdp_utils::Initialize();
-
-		// Load plugins
-		Automation4::ScriptFactory::Register(std::make_unique<Automation4::LuaScriptFactory>());
-		libass::CacheFonts();
-
-		// Load Automation scripts
-		StartupLog("Load global Automation scripts");
-		config::global_scripts = new Automation4::AutoloadScriptManager(OPT_GET("Path/Automation/Autoload")->GetString());
-
-		// Load export filters
-		StartupLog("Register export filters");
-		AssExportFilterChain::Register(std::make_unique<AssFixStylesFilter>());
-		AssExportFilterChain::Register(std::make_unique<AssTransformFramerateFilter>());
-
-		StartupLog("Install PNG handler");
-		wxImage::AddHandler(new wxPNGHandler);
-
-		// Open main frame
-		StartupLog("Create main window");
-		NewProjectContext();
+			exception_message = _("Oops, Aegisub has crashed!\n\nAn attempt has been made to save a copy of your file to:\n\n%s\n\nAegisub will now close.");
+		});
+
+		// Loading the hotkeys and MRU is mostly reading and parsing files, and
+		// nothing before the main window needs them. They have to wait for the
+		// locale to be set up, as changing it while other threads are running
+		// isn't safe.
+		init.Add("Load hotkeys", When::Background, {"Initialize final locale"}, [] {
+			hotkey::init();
+		});
+
+		init.Add("Load MRU", When::Background, {"Initialize final locale"}, [] {
+			config::mru = new agi::MRUManager(config::path->Decode("?user/mru.json"), GET_DEFAULT_CONFIG(default_mru), config::opt);
+		});
+
+		init.Add("Initialize desktop portal", When::Now, {}, [] {
+			agi::xdp_utils::Initialize();
+		});
+
+		init.Add("Load plugins", When::Now, {}, [] {
+			Automation4::ScriptFactory::Register(std::make_unique<Automation4::LuaScriptFactory>());
+			libass::CacheFonts();
+		});
+
+		// The manager has to exist for the automation menu to listen to, but
+		// the scripts themselves aren't loaded until the window is up
+		init.Add("Create global Automation script manager", When::Now, {}, [] {
+			config::global_scripts = new Automation4::AutoloadScriptManager(OPT_GET("Path/Automation/Autoload")->GetString());
+		});
+
+		init.Add("Register export filters", When::Now, {}, [] {
+			AssExportFilterChain::Register(std::make_unique<AssFixStylesFilter>());
+			AssExportFilterChain::Register(std::make_unique<AssTransformFramerateFilter>());
+		});
+
+		init.Add("Install PNG handler", When::Now, {}, [] {
+			wxImage::AddHandler(new wxPNGHandler);
+		});
+
+		init.Add("Create main window", When::Now,
+			{"Load hotkeys", "Load MRU", "Register commands", "Initialize final locale", "Create global Automation script manager"},
+			[this] { NewProjectContext(); });
+
+		init.Add("Parse command line", When::Now, {"Create main window"}, [this] {
+			auto const& args = argv.GetArguments();
+			if (args.size() > 1)
+				OpenFiles(wxArrayStringsAdapter(args.size() - 1, &args[1]));
+		});
+
+		// Loading the autoload scripts is often the slowest part of starting
+		// up, and nothing needs them until the user goes to run one
+		init.Add("Load global Automation scripts", When::Deferred, {"Load plugins", "Create global Automation script manager"}, [] {
+			config::global_scripts->Reload();
+		});
+
+		init.Add("Clean old autosave files", When::Deferred, {}, [] {
+			CleanCache(config::path->Decode(OPT_GET("Path/Auto/Save")->GetString()), "*.AUTOSAVE.ass", 100, 1000);
+		});
+
+		init.Add("Save startup trace", When::Deferred, {}, [] {
+			startup::Finish(config::path->Decode("?user/log/startup_trace.json"));
+		});
 
 		// Version checker
-		StartupLog("Possibly perform automatic updates check");
-		if (OPT_GET("App/First Start")->GetBool()) {
-			OPT_SET("App/First Start")->SetBool(false);
+		init.Add("Possibly perform automatic updates check", When::Deferred, {}, [] {
+			if (OPT_GET("App/First Start")->GetBool()) {
+				OPT_SET("App/First Start")->SetBool(false);
 #ifdef WITH_UPDATE_CHECKER
-			int result = wxMessageBox(_("Do you want Aegisub to check for updates whenever it starts? You can still do it manually via the Help menu."),_("Check for updates?"), wxYES_NO | wxCENTER);
-			OPT_SET("App/Auto/Check For Updates")->SetBool(result == wxYES);
-			try {
-				config::opt->Flush();
-			}
-			catch (agi::fs::FileSystemError const& e) {
-				wxMessageBox(to_wx(e.GetMessage()), _("Error saving config file"), wxOK | wxICON_ERROR | wxCENTER);
-			}
+				int result = wxMessageBox(_("Do you want Aegisub to check for updates whenever it starts? You can still do it manually via the Help menu."),_("Check for updates?"), wxYES_NO | wxCENTER);
+				OPT_SET("App/Auto/Check For Updates")->SetBool(result == wxYES);
+				try {
+					config::opt->Flush();
+				}
+				catch (agi::fs::FileSystemError const& e) {
+					wxMessageBox(to_wx(e.GetMessage()), _("Error saving config file"), wxOK | wxICON_ERROR | wxCENTER);
+				}
 #endif
-		}
+			}
 
 #ifdef WITH_UPDATE_CHECKER
-		PerformVersionCheck(false);
+			PerformVersionCheck(false);
 #endif
+		});
 
-		// Get parameter subs
-		StartupLog("Parse command line");
-		auto const& args = argv.GetArguments();
-		if (args.size() > 1)
-			OpenFiles(wxArrayStringsAdapter(args.size() - 1, &args[1]));
+		init.Run();
 	}
 	catch (agi::Exception const& e) {
 		wxMessageBox(to_wx(e.GetMessage()), _("Fatal error while initializing"));
@@ -328,10 +362,8 @@ bool AegisubApp::OnInit() {
 	}
 #endif
 
-	StartupLog("Clean old autosave files");
-	CleanCache(config::path->Decode(OPT_GET("Path/Auto/Save")->GetString()), "*.AUTOSAVE.ass", 100, 1000);
-
 	StartupLog("Initialization complete");
+	startup::EndPhase();
 	return true;
 }
 
@@ -413,8 +445,8 @@ void AegisubApp::UnhandledException([[maybe_unused]] bool stackWalk) {
 		// Inform user of crash.
 		wxMessageBox(agi::wxformat(exception_message, path), _("Program error"), wxOK | wxICON_ERROR | wxCENTER, nullptr);
 	}
-	else if (LastStartupState) {
-		wxMessageBox(fmt_tl("Aegisub has crashed while starting up!\n\nThe last startup step attempted was: %s.", LastStartupState), _("Program error"), wxOK | wxICON_ERROR | wxCENTER);
+	else if (auto last_phase = startup::LastPhase()) {
+		wxMessageBox(fmt_tl("Aegisub has crashed while starting up!\n\nThe last startup step attempted was: %s.", last_phase), _("Program error"), wxOK | wxICON_ERROR | wxCENTER);
 	}
 #endif
 }
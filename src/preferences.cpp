@@ -463,6 +463,11 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 
 	p->OptionAdd(spectrum, _("Cache memory max (MB)"), "Audio/Renderer/Spectrum/Memory Max", {.min = 2, .max = 1024});
 
+	auto render_cache = p->PageSizer(_("Waveform and spectrum disk cache"));
+	p->OptionAdd(render_cache, _("Enable"), "Audio/Renderer/Cache/Enabled");
+	p->OptionAdd(render_cache, _("Max size (MB)"), "Audio/Renderer/Cache/Size", {.min = 0, .max = 65536});
+	p->OptionAdd(render_cache, _("Max files"), "Audio/Renderer/Cache/Files", {.min = 0, .max = 1000});
+
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
 	const wxString adm_arr[3] = { "ConvertToMono", "GetLeftChannel", "GetRightChannel" };
@@ -512,6 +517,8 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 	wxArrayString sp_choice = to_wx(SubtitlesProviderFactory::GetClasses());
 	p->OptionChoice(expert, _("Subtitles provider"), sp_choice, "Subtitle/Provider");
 
+	p->OptionAdd(expert, _("Frames to decode ahead"), "Provider/Video/Read Ahead", {.min = 0, .max = 64});
+
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
 	p->OptionAdd(avisynth, _("Allow pre-2.56a Avisynth"), "Provider/Avisynth/Allow Ancient");
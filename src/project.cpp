@@ -18,6 +18,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_file_snapshot.h"
 #include "async_video_provider.h"
 #include "audio_controller.h"
 #include "audio_provider_factory.h"
@@ -266,9 +267,10 @@ void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 	if (!progress)
 		progress = new DialogProgress(context->parent);
 
+	std::unique_ptr<agi::AudioProvider> new_provider;
 	try {
 		try {
-			audio_provider = GetAudioProvider(path, *context->path, progress);
+			new_provider = GetAudioProvider(path, *context->path, progress);
 		}
 		catch (agi::UserCancelException const&) { return; }
 		catch (...) {
@@ -294,6 +296,11 @@ void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 		return ShowError(e.GetMessage());
 	}
 
+	// Listeners may be using the old provider from background threads until
+	// they're told about the new one, so it has to outlive the announcement
+	auto old_provider = std::move(audio_provider);
+	audio_provider = std::move(new_provider);
+
 	SetPath(audio_file, "?audio", "Audio", path);
 	AnnounceAudioProviderModified(audio_provider.get());
 }
@@ -329,7 +336,7 @@ bool Project::DoLoadVideo(agi::fs::path const& path) {
 	AnnounceVideoProviderModified(video_provider.get());
 
 	UpdateVideoProperties(context->ass.get(), video_provider.get(), context->parent);
-	video_provider->LoadSubtitles(context->ass.get());
+	video_provider->LoadSubtitles(context->subsController->GetSnapshot());
 
 	timecodes = video_provider->GetFPS();
 	keyframes = video_provider->GetKeyFrames();
@@ -21,6 +21,7 @@
 #include "ass_style.h"
 #include "utils.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
@@ -39,10 +40,10 @@ enum {
 };
 
 namespace {
-	std::string transform_drawing(std::string const& drawing, int shift_x, int shift_y, double scale_x, double scale_y) {
+	std::string transform_drawing(std::string_view drawing, int shift_x, int shift_y, double scale_x, double scale_y) {
 		bool is_x = true;
 		std::string final;
-		final.reserve(drawing.size());
+		final.reserve(drawing.size() + drawing.size() / 4);
 
 		for (auto cur : agi::Split(drawing, ' ')) {
 			double val;
@@ -51,7 +52,7 @@ namespace {
 					val = (val + shift_x) * scale_x;
 				else
 					val = (val + shift_y) * scale_y;
-				final += float_to_string(val);
+				append_float_string(final, val);
 				final += ' ';
 				is_x = !is_x;
 			}
@@ -138,10 +139,13 @@ namespace {
 			cur->Set<int>((cur->Get<int>() + shift) * resizer + 0.5);
 	}
 
-	void resample_line(resample_state *state, AssDialogue &diag) {
-		if (diag.Comment && (diag.Effect.get().starts_with("template") || diag.Effect.get().starts_with("code")))
-			return;
+	bool is_template(AssDialogue const& diag) {
+		return diag.Comment && (diag.Effect.get().starts_with("template") || diag.Effect.get().starts_with("code"));
+	}
 
+	/// Get the resampled text of a line. This only reads from the line and
+	/// the state, so it can be called for many lines at once.
+	std::string resample_text(resample_state *state, AssDialogue const& diag) {
 		auto blocks = diag.ParseTags();
 
 		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
@@ -150,12 +154,18 @@ namespace {
 		for (auto drawing : blocks | agi::of_type<AssDialogueBlockDrawing>())
 			drawing->text = transform_drawing(drawing->text, 0, 0, state->rx / state->ar, state->ry);
 
+		std::string text;
+		text.reserve(diag.Text.get().size() + diag.Text.get().size() / 4);
+		for (auto& block : blocks)
+			text += block->GetText();
+		return text;
+	}
+
+	void resample_margins(resample_state *state, AssDialogue &diag) {
 		for (size_t i = 0; i < 3; ++i) {
 			if (diag.Margin[i])
 				diag.Margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
 		}
-
-		diag.UpdateText(blocks);
 	}
 
 	void resample_style(resample_state *state, AssStyle &style) {
@@ -268,8 +278,25 @@ void ResampleResolution(AssFile *ass, ResampleSettings settings) {
 
 	for (auto& line : ass->Styles)
 		resample_style(&state, line);
-	for (auto& line : ass->Events)
-		resample_line(&state, line);
+
+	// Rewriting the text of each line is independent of every other line, so
+	// do that in parallel and then update the lines in order
+	std::vector<AssDialogue *> lines;
+	lines.reserve(ass->Events.size());
+	for (auto& line : ass->Events) {
+		if (!is_template(line))
+			lines.push_back(&line);
+	}
+
+	std::vector<std::string> text(lines.size());
+	agi::dispatch::ParallelFor(lines.size(), [&](size_t i) {
+		text[i] = resample_text(&state, *lines[i]);
+	});
+
+	for (size_t i = 0; i < lines.size(); ++i) {
+		resample_margins(&state, *lines[i]);
+		lines[i]->Text = std::move(text[i]);
+	}
 
 	ass->SetScriptInfo("PlayResX", std::to_string(settings.dest_x));
 	ass->SetScriptInfo("PlayResY", std::to_string(settings.dest_y));
@@ -23,10 +23,12 @@
 #include "selection_controller.h"
 #include "text_selection_controller.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/util.h>
 
 #include <boost/locale/conversion.hpp>
+#include <numeric>
 
 #include <wx/msgdlg.h>
 
@@ -44,8 +46,19 @@ auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDial
 	throw agi::InternalError("Bad field for search");
 }
 
+bool is_ascii(std::string const& str) {
+	for (char c : str) {
+		if (c & 0x80)
+			return false;
+	}
+	return true;
+}
+
 std::string const& get_normalized(const AssDialogue *diag, decltype(&AssDialogueBase::Text) field) {
 	auto& value = const_cast<AssDialogue*>(diag)->*field;
+	// ASCII text is always already normalized
+	if (is_ascii(value.get()))
+		return value.get();
 	auto normalized = boost::locale::normalize(value.get());
 	if (normalized != value)
 		value = normalized;
@@ -238,36 +251,50 @@ bool SearchReplaceEngine::ReplaceAll() {
 	if (!initialized)
 		return false;
 
-	size_t count = 0;
-
 	auto matches = GetMatcher(settings);
 
 	auto const& sel = context->selectionController->GetSelectedSet();
 	bool selection_only = settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
 
+	std::vector<AssDialogue *> lines;
 	for (auto& diag : context->ass->Events) {
 		if (selection_only && !sel.count(&diag)) continue;
 		if (settings.ignore_comments && diag.Comment) continue;
+		lines.push_back(&diag);
+	}
 
-		if (settings.use_regex) {
-			if (MatchState ms = matches(&diag, 0)) {
-				auto& diag_field = diag.*get_dialogue_field(settings.field);
-				std::string const& text = diag_field.get();
-				count += std::distance(
-					boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
-					boost::u32regex_iterator<std::string::const_iterator>());
-				diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+	// Each line is only touched by the task handling its block, and each
+	// task needs its own copy of the matcher as matchers have state
+	constexpr size_t block_size = 256;
+	std::vector<size_t> counts((lines.size() + block_size - 1) / block_size);
+	agi::dispatch::ParallelFor(counts.size(), [&](size_t i) {
+		auto block_matches = matches;
+		size_t last = std::min(lines.size(), (i + 1) * block_size);
+		for (size_t j = i * block_size; j < last; ++j) {
+			auto& diag = *lines[j];
+
+			if (settings.use_regex) {
+				if (MatchState ms = block_matches(&diag, 0)) {
+					auto& diag_field = diag.*get_dialogue_field(settings.field);
+					std::string const& text = diag_field.get();
+					counts[i] += std::distance(
+						boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
+						boost::u32regex_iterator<std::string::const_iterator>());
+					diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+				}
+				continue;
 			}
-			continue;
-		}
 
-		size_t pos = 0;
-		while (MatchState ms = matches(&diag, pos)) {
-			++count;
-			Replace(&diag, ms);
-			pos = ms.end;
+			size_t pos = 0;
+			while (MatchState ms = block_matches(&diag, pos)) {
+				++counts[i];
+				Replace(&diag, ms);
+				pos = ms.end;
+			}
 		}
-	}
+	});
+
+	size_t count = std::accumulate(counts.begin(), counts.end(), size_t(0));
 
 	if (count > 0) {
 		context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT);
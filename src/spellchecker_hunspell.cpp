@@ -31,6 +31,11 @@
 #undef near
 #include <hunspell.hxx>
 
+namespace {
+/// Maximum number of words to remember the result of checking
+constexpr size_t max_checked_words = 100000;
+}
+
 HunspellSpellChecker::HunspellSpellChecker()
 : lang_listener(OPT_SUB("Tool/Spell Checker/Language", &HunspellSpellChecker::OnLanguageChanged, this))
 , dict_path_listener(OPT_SUB("Path/Dictionary", &HunspellSpellChecker::OnPathChanged, this))
@@ -41,6 +46,7 @@ HunspellSpellChecker::HunspellSpellChecker()
 HunspellSpellChecker::~HunspellSpellChecker() = default;
 
 bool HunspellSpellChecker::CanAddWord(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	if (!hunspell) return false;
 	try {
 		conv->Convert(word);
@@ -52,14 +58,17 @@ bool HunspellSpellChecker::CanAddWord(std::string_view word) {
 }
 
 bool HunspellSpellChecker::CanRemoveWord(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	return !!customWords.count(word);
 }
 
 void HunspellSpellChecker::AddWord(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	if (!hunspell) return;
 
 	// Add it to the in-memory dictionary
 	hunspell->add(conv->Convert(word));
+	checkedWords.clear();
 
 	// Add the word
 	if (customWords.insert(std::string(word)).second)
@@ -67,10 +76,12 @@ void HunspellSpellChecker::AddWord(std::string_view word) {
 }
 
 void HunspellSpellChecker::RemoveWord(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	if (!hunspell) return;
 
 	// Remove it from the in-memory dictionary
 	hunspell->remove(conv->Convert(word));
+	checkedWords.clear();
 
 	auto word_iter = customWords.find(word);
 	if (word_iter != customWords.end()) {
@@ -115,16 +126,29 @@ void HunspellSpellChecker::WriteUserDictionary() {
 }
 
 bool HunspellSpellChecker::CheckWord(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	if (!hunspell) return true;
+
+	auto it = checkedWords.find(word);
+	if (it != checkedWords.end())
+		return it->second;
+
+	bool correct;
 	try {
-		return hunspell->spell(conv->Convert(word));
+		correct = hunspell->spell(conv->Convert(word));
 	}
 	catch (agi::charset::ConvError const&) {
-		return false;
+		correct = false;
 	}
+
+	if (checkedWords.size() >= max_checked_words)
+		checkedWords.clear();
+	checkedWords.emplace(word, correct);
+	return correct;
 }
 
 std::vector<std::string> HunspellSpellChecker::GetSuggestions(std::string_view word) {
+	std::lock_guard<std::mutex> guard(lock);
 	std::vector<std::string> suggestions;
 	if (!hunspell) return suggestions;
 
@@ -174,7 +198,9 @@ static bool check_path(agi::fs::path const& path, std::string_view language,
 }
 
 void HunspellSpellChecker::OnLanguageChanged() {
+	std::lock_guard<std::mutex> guard(lock);
 	hunspell.reset();
+	checkedWords.clear();
 
 	auto language = OPT_GET("Tool/Spell Checker/Language")->GetString();
 	if (language.empty()) return;
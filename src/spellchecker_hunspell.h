@@ -26,7 +26,9 @@
 #include <libaegisub/signal.h>
 
 #include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 
 namespace agi { namespace charset { class IconvWrapper; } }
 class Hunspell;
@@ -49,6 +51,19 @@ class HunspellSpellChecker final : public agi::SpellChecker {
 	/// Words in the custom user dictionary
 	std::set<std::string, std::less<>> customWords;
 
+	struct WordHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+	};
+
+	/// Results of CheckWord for the current dictionary, as the same words
+	/// get checked over and over again when re-highlighting lines
+	std::unordered_map<std::string, bool, WordHash, std::equal_to<>> checkedWords;
+
+	/// Guards the dictionary, as the spell checker dialog checks words in the
+	/// background while they're also being checked on the GUI thread
+	std::mutex lock;
+
 	/// Dictionary language change connection
 	agi::signal::Connection lang_listener;
 	/// Dictionary language change handler
@@ -0,0 +1,230 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file startup.cpp
+/// @brief Tracing and scheduling of the steps of application startup
+/// @ingroup main
+
+#include "startup.h"
+
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/writer.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/exception.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+/// Times are relative to when the program was loaded
+const clock::time_point origin = clock::now();
+const std::thread::id main_thread = std::this_thread::get_id();
+
+struct Event {
+	const char *name;
+	int thread;
+	/// Microseconds since origin
+	int64_t start;
+	/// Microseconds, or -1 for a mark
+	int64_t duration;
+};
+
+std::mutex events_lock;
+std::vector<Event> events;
+bool finished = false;
+
+std::atomic<int> thread_count{0};
+std::atomic<const char *> last_phase{nullptr};
+
+/// The main thread is always thread 0 in the trace
+thread_local const int thread_index = std::this_thread::get_id() == main_thread ? 0 : ++thread_count;
+thread_local const char *open_phase = nullptr;
+thread_local int64_t open_phase_start = 0;
+
+int64_t Now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - origin).count();
+}
+
+void Record(const char *name, int64_t start, int64_t duration) {
+	std::lock_guard<std::mutex> lock(events_lock);
+	if (!finished)
+		events.push_back({name, thread_index, start, duration});
+}
+}
+
+namespace startup {
+void Phase(const char *name) {
+	EndPhase();
+	open_phase = name;
+	open_phase_start = Now();
+	if (thread_index == 0)
+		last_phase = name;
+}
+
+void EndPhase() {
+	if (!open_phase) return;
+	Record(open_phase, open_phase_start, Now() - open_phase_start);
+	open_phase = nullptr;
+}
+
+void Mark(const char *name) {
+	Record(name, Now(), -1);
+}
+
+const char *LastPhase() {
+	return last_phase;
+}
+
+void Finish(agi::fs::path const& trace_file) {
+	EndPhase();
+
+	std::vector<Event> trace;
+	{
+		std::lock_guard<std::mutex> lock(events_lock);
+		finished = true;
+		trace.swap(events);
+	}
+	std::stable_sort(begin(trace), end(trace), [](Event const& a, Event const& b) { return a.start < b.start; });
+
+	json::Array trace_events;
+	json::Object thread_name;
+	thread_name["name"] = "thread_name";
+	thread_name["ph"] = "M";
+	thread_name["pid"] = 1;
+	thread_name["tid"] = 0;
+	json::Object thread_args;
+	thread_args["name"] = "main";
+	thread_name["args"] = std::move(thread_args);
+	trace_events.push_back(std::move(thread_name));
+
+	for (auto const& e : trace) {
+		json::Object event;
+		event["name"] = e.name;
+		event["cat"] = "startup";
+		event["pid"] = 1;
+		event["tid"] = e.thread;
+		event["ts"] = e.start;
+		if (e.duration < 0) {
+			LOG_I("main/startup") << e.name << " at " << e.start / 1000 << "ms";
+			event["ph"] = "i";
+			event["s"] = "g";
+		}
+		else {
+			LOG_I("main/startup") << e.name << " took " << e.duration / 1000 << "ms, starting at "
+				<< e.start / 1000 << "ms on thread " << e.thread;
+			event["ph"] = "X";
+			event["dur"] = e.duration;
+		}
+		trace_events.push_back(std::move(event));
+	}
+
+	json::Object root;
+	root["traceEvents"] = std::move(trace_events);
+	root["displayTimeUnit"] = "ms";
+
+	try {
+		agi::JsonWriter::Write(root, agi::io::Save(trace_file).Get());
+	}
+	catch (agi::fs::FileSystemError const& e) {
+		LOG_E("main/startup") << "Cannot save startup trace: " << e.GetMessage();
+	}
+}
+
+void Scheduler::Add(const char *name, When when, std::vector<const char *> const& deps, std::function<void()> func) {
+	Task task{name, when, {}, std::move(func), {}};
+	for (auto dep : deps) {
+		auto it = std::find_if(begin(tasks), end(tasks), [&](Task const& t) { return !strcmp(t.name, dep); });
+		if (it == end(tasks))
+			throw agi::InternalError(std::string("Startup task ") + name + " depends on " + dep + ", which hasn't been added");
+		if (it->when == When::Deferred && when != When::Deferred)
+			throw agi::InternalError(std::string("Startup task ") + name + " depends on " + dep + ", which runs after it");
+		task.deps.push_back(it - begin(tasks));
+	}
+	tasks.push_back(std::move(task));
+}
+
+void Scheduler::Run() {
+	std::vector<std::shared_future<void>> background;
+
+	for (auto& task : tasks) {
+		std::vector<std::shared_future<void>> deps;
+		for (size_t dep : task.deps)
+			deps.push_back(tasks[dep].done);
+
+		if (task.when == When::Now) {
+			for (auto& dep : deps)
+				dep.get();
+			Phase(task.name);
+			task.func();
+			EndPhase();
+
+			std::promise<void> done;
+			done.set_value();
+			task.done = done.get_future().share();
+		}
+		else if (task.when == When::Background) {
+			auto done = std::make_shared<std::promise<void>>();
+			task.done = done->get_future().share();
+			background.push_back(task.done);
+
+			// The background queue starts thunks in the order they were
+			// queued, so a task's background dependencies are always either
+			// finished or running elsewhere by the time it starts waiting
+			agi::dispatch::Background().Async([=, name = task.name, func = std::move(task.func)] {
+				try {
+					for (auto& dep : deps)
+						dep.get();
+					Phase(name);
+					func();
+					EndPhase();
+					done->set_value();
+				}
+				catch (...) {
+					EndPhase();
+					done->set_exception(std::current_exception());
+				}
+			});
+		}
+	}
+
+	for (auto& done : background)
+		done.get();
+
+	// Each deferred task is queued separately so that the UI can respond to
+	// events between them. Their dependencies have all finished by now, or
+	// are deferred tasks queued ahead of them.
+	bool first = true;
+	for (auto& task : tasks) {
+		if (task.when != When::Deferred) continue;
+		agi::dispatch::Main().Async([=, name = task.name, func = std::move(task.func)] {
+			if (first)
+				Mark("Event loop started");
+			Phase(name);
+			func();
+			EndPhase();
+		});
+		first = false;
+	}
+}
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file startup.h
+/// @brief Tracing and scheduling of the steps of application startup
+/// @ingroup main
+
+#pragma once
+
+#include <libaegisub/fs.h>
+
+#include <functional>
+#include <future>
+#include <vector>
+
+namespace startup {
+/// @brief Mark the start of a step of startup on the calling thread
+/// @param name Name of the step, which must outlive the program
+///
+/// This also ends the previous step started on this thread, so a series of
+/// calls splits a sequence of work into steps.
+void Phase(const char *name);
+
+/// End the calling thread's current step without starting another
+void EndPhase();
+
+/// Record that something happened at the current time
+void Mark(const char *name);
+
+/// Get the step most recently started on the main thread, for reporting
+/// crashes during startup
+const char *LastPhase();
+
+/// @brief Stop recording and report how long each step took
+/// @param trace_file File to write the steps to in the Chrome trace event
+///                   format, which chrome://tracing and Perfetto can display
+void Finish(agi::fs::path const& trace_file);
+
+/// @class Scheduler
+/// @brief Runs the steps of startup in dependency order
+///
+/// Each task is traced as a step named after the task. A task may only
+/// depend on tasks added before it, so the order of Add calls is always a
+/// valid order to run them in serially.
+class Scheduler {
+public:
+	enum class When {
+		/// Run on the main thread before Run returns
+		Now,
+		/// Run on the background queue alongside the main thread's tasks,
+		/// finishing before Run returns
+		Background,
+		/// Run on the main thread once the event loop has started, so after
+		/// the main window has been shown
+		Deferred
+	};
+
+private:
+	struct Task {
+		const char *name;
+		When when;
+		std::vector<size_t> deps;
+		std::function<void()> func;
+		std::shared_future<void> done;
+	};
+	std::vector<Task> tasks;
+
+public:
+	/// @brief Add a task
+	/// @param name Name of the task, which must outlive the program
+	/// @param when Where and when to run the task
+	/// @param deps Names of the tasks which must finish before this one starts
+	/// @param func The task
+	void Add(const char *name, When when, std::vector<const char *> const& deps, std::function<void()> func);
+
+	/// Run all of the tasks, rethrowing the first exception thrown by a Now
+	/// or Background task
+	void Run();
+};
+}
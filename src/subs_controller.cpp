@@ -19,6 +19,7 @@
 #include "ass_attachment.h"
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_file_snapshot.h"
 #include "ass_info.h"
 #include "ass_style.h"
 #include "compat.h"
@@ -30,6 +31,7 @@
 #include "project.h"
 #include "selection_controller.h"
 #include "subtitle_format.h"
+#include "subtitle_format_ass.h"
 #include "text_selection_controller.h"
 
 #include <libaegisub/dispatch.h>
@@ -38,6 +40,10 @@
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <unordered_map>
 #include <wx/msgdlg.h>
 
 namespace {
@@ -48,44 +54,422 @@ namespace {
 		else
 			timer->Stop();
 	}
-}
 
-struct SubsController::UndoInfo {
-	wxString undo_description;
-	int commit_id;
+	bool same_line(AssDialogueBase const& a, AssDialogueBase const& b) {
+		return a.Comment == b.Comment
+			&& a.Layer == b.Layer
+			&& a.Margin == b.Margin
+			&& a.Start == b.Start
+			&& a.End == b.End
+			&& a.Style == b.Style
+			&& a.Actor == b.Actor
+			&& a.Effect == b.Effect
+			&& a.ExtradataIds == b.ExtradataIds
+			&& a.Text == b.Text;
+	}
+
+	bool same_attachment(AssAttachment const& a, AssAttachment const& b) {
+		// The data is flyweighted, so unmodified attachments can usually be
+		// identified without comparing megabytes of font data
+		return a.Group() == b.Group()
+			&& (&a.GetEntryData() == &b.GetEntryData() || a.GetEntryData() == b.GetEntryData());
+	}
+
+	bool same_extradata(ExtradataEntry const& a, ExtradataEntry const& b) {
+		return a.id == b.id && a.key == b.key && a.value == b.value;
+	}
+
+	struct LineChange {
+		/// Index of the line in the version of the file which contains it
+		size_t index;
+		AssDialogueBase line;
+	};
+
+	struct LineModification {
+		size_t before_index;
+		size_t after_index;
+		AssDialogueBase before;
+		AssDialogueBase after;
+	};
+
+	/// Copy src into a new list, skipping the lines at the indices in drop and
+	/// inserting the lines in insert at their indices in the result
+	std::vector<AssDialogueBase> merge_lines(std::vector<AssDialogueBase>& src, std::vector<LineChange> const& drop, std::vector<LineChange> const& insert) {
+		std::vector<AssDialogueBase> out;
+		out.reserve(src.size() - drop.size() + insert.size());
+
+		auto to_drop = drop.begin();
+		auto to_insert = insert.begin();
+		for (size_t i = 0; i < src.size(); ++i) {
+			if (to_drop != drop.end() && to_drop->index == i) {
+				++to_drop;
+				continue;
+			}
+			for (; to_insert != insert.end() && to_insert->index == out.size(); ++to_insert)
+				out.push_back(to_insert->line);
+			out.push_back(std::move(src[i]));
+		}
+		for (; to_insert != insert.end(); ++to_insert)
+			out.push_back(to_insert->line);
+		return out;
+	}
 
+	template<typename T>
+	struct SectionChange {
+		T before;
+		T after;
+	};
+}
+
+struct SubsController::UndoState {
 	std::vector<std::pair<std::string, std::string>> script_info;
 	std::vector<AssStyle> styles;
 	std::vector<AssDialogueBase> events;
 	std::vector<AssAttachment> attachments;
 	std::vector<ExtradataEntry> extradata;
 
+	/// Index in events of each line ID
+	std::unordered_map<int, size_t> event_index;
+
+	/// Shareable copy of the above
+	AssFileSnapshot snapshot;
+
+	void IndexEvents() {
+		event_index.clear();
+		event_index.reserve(events.size());
+		for (size_t i = 0; i < events.size(); ++i)
+			event_index.emplace(events[i].Id, i);
+	}
+
+	void Reset(const AssFile *ass) {
+		script_info.clear();
+		script_info.reserve(ass->Info.size());
+		for (auto const& info : ass->Info)
+			script_info.emplace_back(info.Key(), info.Value());
+
+		styles.assign(ass->Styles.begin(), ass->Styles.end());
+		events.assign(ass->Events.begin(), ass->Events.end());
+		attachments = ass->Attachments;
+		extradata = ass->Extradata;
+		IndexEvents();
+
+		snapshot.SetScriptInfo(script_info);
+		snapshot.SetStyles(styles);
+		snapshot.SetEvents(events);
+		snapshot.SetAttachments(attachments);
+		snapshot.SetExtradata(extradata);
+	}
+
+	/// Does the snapshot have the same contents as the file?
+	bool Matches(const AssFile *ass) const {
+		auto const& info = snapshot.GetScriptInfo();
+		if (!std::equal(ass->Info.begin(), ass->Info.end(), info.begin(), info.end(),
+			[](AssInfo const& a, std::pair<std::string, std::string> const& b) { return a.Key() == b.first && a.Value() == b.second; }))
+			return false;
+
+		auto const& snapshot_styles = snapshot.GetStyles();
+		if (!std::equal(ass->Styles.begin(), ass->Styles.end(), snapshot_styles.begin(), snapshot_styles.end(),
+			[](AssStyle const& a, AssStyle const& b) { return a.GetEntryData() == b.GetEntryData(); }))
+			return false;
+
+		if (snapshot.GetEventCount() != ass->Events.size())
+			return false;
+		auto line = ass->Events.begin();
+		for (auto const& chunk : snapshot.GetEventChunks()) {
+			for (auto const& snapshot_line : *chunk) {
+				if (line->Id != snapshot_line.Id || !same_line(*line, snapshot_line))
+					return false;
+				++line;
+			}
+		}
+
+		auto const& snapshot_attachments = snapshot.GetAttachments();
+		auto const& snapshot_extradata = snapshot.GetExtradata();
+		return std::equal(ass->Attachments.begin(), ass->Attachments.end(), snapshot_attachments.begin(), snapshot_attachments.end(), same_attachment)
+			&& std::equal(ass->Extradata.begin(), ass->Extradata.end(), snapshot_extradata.begin(), snapshot_extradata.end(), same_extradata);
+	}
+};
+
+/// An entry on the undo stack. Rather than a copy of the file, each entry
+/// stores just what its commit changed relative to the entry below it, in a
+/// form which can be applied in either direction, with the exception of the
+/// entry at the bottom of the stack which has nothing to be undone to.
+struct SubsController::UndoInfo {
+	wxString undo_description;
+	int commit_id;
+
+	/// Is this the initial state of the file rather than a change?
+	bool base = false;
+
+	std::optional<SectionChange<std::vector<std::pair<std::string, std::string>>>> script_info;
+	std::optional<SectionChange<std::vector<AssStyle>>> styles;
+	std::optional<SectionChange<std::vector<AssAttachment>>> attachments;
+	std::optional<SectionChange<std::vector<ExtradataEntry>>> extradata;
+
+	/// Removed lines, sorted by their index before the commit
+	std::vector<LineChange> removed_lines;
+	/// Added lines, sorted by their index after the commit
+	std::vector<LineChange> added_lines;
+	std::vector<LineModification> modified_lines;
+	/// If lines were reordered, the index before the commit of each line after
+	/// the commit, or -1 for added lines. Empty if the order was preserved.
+	std::vector<int> line_sources;
+	size_t lines_before = 0;
+	size_t lines_after = 0;
+
 	mutable std::vector<int> selection;
 	int active_line_id = 0;
 	int pos = 0, sel_start = 0, sel_end = 0;
 
-	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
+	UndoInfo(const agi::Context *c, UndoState &state, wxString const& d, int commit_id, int type, const AssDialogue *single_line, bool base)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
+	, base(base)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
-			script_info.emplace_back(info.Key(), info.Value());
-
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
-
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
+		Record(c->ass.get(), state, type, single_line);
 
 		UpdateActiveLine(c);
 		UpdateSelection(c);
 		UpdateTextSelection(c);
 	}
 
-	void Apply(agi::Context *c) const {
+	/// Record the changes between state and the file, and update state to match
+	void Record(const AssFile *ass, UndoState &state, int type, const AssDialogue *single_line) {
+		if (base) {
+			state.Reset(ass);
+			return;
+		}
+
+		script_info.reset();
+		styles.reset();
+		attachments.reset();
+		extradata.reset();
+		removed_lines.clear();
+		added_lines.clear();
+		modified_lines.clear();
+		line_sources.clear();
+		lines_before = lines_after = state.events.size();
+
+		RecordScriptInfo(ass, state);
+		RecordStyles(ass, state);
+		RecordAttachments(ass, state);
+		RecordExtradata(ass, state);
+
+		// Only the sections which the commit claims to have changed are
+		// checked, so that the cost of a commit scales with what it touched
+		bool structural = type == AssFile::COMMIT_NEW || (type & (AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM));
+		bool recorded = single_line && !structural && RecordLine(*single_line, state);
+		if (!recorded && (structural || (type & AssFile::COMMIT_DIAG_FULL)))
+			RecordLines(ass, state);
+
+		Reapply(state);
+	}
+
+	/// Fold a further change to a single line into this entry, which must be
+	/// the most recent one applied to state
+	void Amend(const AssFile *ass, UndoState &state, AssDialogue const& line) {
+		if (base) {
+			state.Reset(ass);
+			return;
+		}
+
+		// If this entry didn't add, remove or reorder lines, the line's index
+		// is the same before and after it, so the change can be merged into
+		// the existing modifications
+		bool structural = !removed_lines.empty() || !added_lines.empty() || !line_sources.empty();
+		auto it = state.event_index.find(line.Id);
+		if (!structural && it != state.event_index.end()) {
+			size_t index = it->second;
+			auto modified = find_if(begin(modified_lines), end(modified_lines),
+				[=](LineModification const& m) { return m.after_index == index; });
+			if (modified == end(modified_lines)) {
+				if (same_line(state.events[index], line)) return;
+				modified_lines.push_back({index, index, state.events[index], line});
+			}
+			else if (same_line(modified->before, line))
+				modified_lines.erase(modified);
+			else
+				modified->after = line;
+
+			state.events[index] = line;
+			state.snapshot.SetEvents(state.events, {index});
+			return;
+		}
+
+		// Otherwise diff everything against the state from before this entry
+		// so that none of the entry's existing changes are lost
+		Revert(state);
+		Record(ass, state, AssFile::COMMIT_DIAG_FULL, nullptr);
+	}
+
+	void RecordScriptInfo(const AssFile *ass, UndoState &state) {
+		bool changed = ass->Info.size() != state.script_info.size();
+		for (size_t i = 0; !changed && i < ass->Info.size(); ++i)
+			changed = ass->Info[i].Key() != state.script_info[i].first || ass->Info[i].Value() != state.script_info[i].second;
+		if (!changed) return;
+
+		script_info.emplace();
+		script_info->before = state.script_info;
+		for (auto const& info : ass->Info)
+			script_info->after.emplace_back(info.Key(), info.Value());
+	}
+
+	void RecordStyles(const AssFile *ass, UndoState &state) {
+		if (std::equal(ass->Styles.begin(), ass->Styles.end(), state.styles.begin(), state.styles.end(),
+			[](AssStyle const& a, AssStyle const& b) { return a.GetEntryData() == b.GetEntryData(); }))
+			return;
+
+		styles.emplace();
+		styles->before = state.styles;
+		styles->after.assign(ass->Styles.begin(), ass->Styles.end());
+	}
+
+	void RecordAttachments(const AssFile *ass, UndoState &state) {
+		if (std::equal(ass->Attachments.begin(), ass->Attachments.end(), state.attachments.begin(), state.attachments.end(), same_attachment))
+			return;
+
+		attachments.emplace();
+		attachments->before = state.attachments;
+		attachments->after = ass->Attachments;
+	}
+
+	void RecordExtradata(const AssFile *ass, UndoState &state) {
+		if (std::equal(ass->Extradata.begin(), ass->Extradata.end(), state.extradata.begin(), state.extradata.end(), same_extradata))
+			return;
+
+		extradata.emplace();
+		extradata->before = state.extradata;
+		extradata->after = ass->Extradata;
+	}
+
+	/// Record a change to a single line which is known to be the only line changed
+	/// @return false if the line is not one which was already in the file
+	bool RecordLine(AssDialogue const& line, UndoState &state) {
+		auto it = state.event_index.find(line.Id);
+		if (it == state.event_index.end()) return false;
+		auto const& before = state.events[it->second];
+		if (!same_line(before, line))
+			modified_lines.push_back({it->second, it->second, before, line});
+		return true;
+	}
+
+	/// Find all the differences between the lines in the file and state
+	void RecordLines(const AssFile *ass, UndoState &state) {
+		std::vector<bool> seen(state.events.size());
+		std::vector<int> sources;
+		sources.reserve(state.events.size());
+		bool reordered = false;
+		size_t last_source = 0;
+
+		size_t index = 0;
+		for (auto const& line : ass->Events) {
+			auto it = state.event_index.find(line.Id);
+			if (it == state.event_index.end() || seen[it->second]) {
+				added_lines.push_back({index, line});
+				sources.push_back(-1);
+			}
+			else {
+				size_t source = it->second;
+				seen[source] = true;
+				sources.push_back(static_cast<int>(source));
+				if (source < last_source)
+					reordered = true;
+				last_source = source;
+
+				auto const& before = state.events[source];
+				if (!same_line(before, line))
+					modified_lines.push_back({source, index, before, line});
+			}
+			++index;
+		}
+
+		for (size_t i = 0; i < seen.size(); ++i) {
+			if (!seen[i])
+				removed_lines.push_back({i, state.events[i]});
+		}
+
+		lines_after = index;
+		if (reordered)
+			line_sources = std::move(sources);
+	}
+
+	/// Apply this entry's changes to the state it was recorded relative to
+	void Reapply(UndoState &state) const {
+		if (script_info) state.script_info = script_info->after;
+		if (styles) state.styles = styles->after;
+		if (attachments) state.attachments = attachments->after;
+		if (extradata) state.extradata = extradata->after;
+
+		bool structural = !removed_lines.empty() || !added_lines.empty() || !line_sources.empty();
+		if (!line_sources.empty()) {
+			std::vector<AssDialogueBase> events(lines_after);
+			for (size_t i = 0; i < line_sources.size(); ++i) {
+				if (line_sources[i] >= 0)
+					events[i] = std::move(state.events[line_sources[i]]);
+			}
+			for (auto const& added : added_lines)
+				events[added.index] = added.line;
+			state.events = std::move(events);
+		}
+		else if (structural)
+			state.events = merge_lines(state.events, removed_lines, added_lines);
+
+		for (auto const& modified : modified_lines)
+			state.events[modified.after_index] = modified.after;
+
+		if (structural)
+			state.IndexEvents();
+		UpdateSnapshot(state, true);
+	}
+
+	/// Undo this entry's changes to state
+	void Revert(UndoState &state) const {
+		if (script_info) state.script_info = script_info->before;
+		if (styles) state.styles = styles->before;
+		if (attachments) state.attachments = attachments->before;
+		if (extradata) state.extradata = extradata->before;
+
+		bool structural = !removed_lines.empty() || !added_lines.empty() || !line_sources.empty();
+		if (!line_sources.empty()) {
+			std::vector<AssDialogueBase> events(lines_before);
+			for (size_t i = 0; i < line_sources.size(); ++i) {
+				if (line_sources[i] >= 0)
+					events[line_sources[i]] = std::move(state.events[i]);
+			}
+			for (auto const& removed : removed_lines)
+				events[removed.index] = removed.line;
+			state.events = std::move(events);
+		}
+		else if (structural)
+			state.events = merge_lines(state.events, added_lines, removed_lines);
+
+		for (auto const& modified : modified_lines)
+			state.events[modified.before_index] = modified.before;
+
+		if (structural)
+			state.IndexEvents();
+		UpdateSnapshot(state, false);
+	}
+
+	/// Bring the state's snapshot up to date after applying this entry to it
+	void UpdateSnapshot(UndoState &state, bool forward) const {
+		if (script_info) state.snapshot.SetScriptInfo(state.script_info);
+		if (styles) state.snapshot.SetStyles(state.styles);
+		if (attachments) state.snapshot.SetAttachments(state.attachments);
+		if (extradata) state.snapshot.SetExtradata(state.extradata);
+
+		if (!removed_lines.empty() || !added_lines.empty() || !line_sources.empty())
+			state.snapshot.SetEvents(state.events);
+		else if (!modified_lines.empty()) {
+			std::vector<size_t> changed;
+			changed.reserve(modified_lines.size());
+			for (auto const& modified : modified_lines)
+				changed.push_back(forward ? modified.after_index : modified.before_index);
+			state.snapshot.SetEvents(state.events, changed);
+		}
+	}
+
+	void Apply(agi::Context *c, UndoState const& state) const {
 		// Keep old dialogue lines alive until after the commit is complete
 		// since a bunch of stuff holds references to them
 		AssFile old;
@@ -100,12 +484,12 @@ struct SubsController::UndoInfo {
 		AssDialogue *active_line = nullptr;
 		Selection new_sel;
 
-		for (auto const& info : script_info)
+		for (auto const& info : state.script_info)
 			c->ass->Info.push_back(*new AssInfo(info.first, info.second));
-		for (auto const& style : styles)
+		for (auto const& style : state.styles)
 			c->ass->Styles.push_back(*new AssStyle(style));
-		c->ass->Attachments = attachments;
-		for (auto const& event : events) {
+		c->ass->Attachments = state.attachments;
+		for (auto const& event : state.events) {
 			auto copy = new AssDialogue(event);
 			c->ass->Events.push_back(*copy);
 			if (copy->Id == active_line_id)
@@ -113,7 +497,7 @@ struct SubsController::UndoInfo {
 			if (binary_search(begin(selection), end(selection), copy->Id))
 				new_sel.insert(copy);
 		}
-		c->ass->Extradata = extradata;
+		c->ass->Extradata = state.extradata;
 
 		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
@@ -145,9 +529,11 @@ struct SubsController::UndoInfo {
 
 SubsController::SubsController(agi::Context *context)
 : context(context)
+, undo_state(std::make_unique<UndoState>())
 , undo_connection(context->ass->AddUndoManager(&SubsController::OnCommit, this))
 , text_selection_connection(context->textSelectionController->AddSelectionListener(&SubsController::OnTextSelectionChanged, this))
 , autosave_queue(agi::dispatch::Create())
+, autosave_cache(std::make_unique<AssEventTextCache>())
 {
 	autosave_timer_changed(&autosave_timer);
 	BindConnection(OPT_SUB("App/Auto/Save", [this] { autosave_timer_changed(&autosave_timer); }));
@@ -266,16 +652,20 @@ void SubsController::AutoSave() {
 
 	autosaved_commit_id = commit_id;
 	auto frame = context->frame;
-	auto subs_copy = new AssFile(*context->ass);
-	autosave_queue->Async([subs_copy, name, directory, frame] {
+	auto snapshot = GetSnapshot();
+	auto properties = context->ass->Properties;
+	auto cache = autosave_cache.get();
+	autosave_queue->Async([snapshot, properties, name, directory, frame, cache] {
 		wxString msg;
-		std::unique_ptr<AssFile> subs(subs_copy);
 
 		try {
 			agi::fs::CreateDirectory(directory);
 			auto path = directory /  agi::format("%s.%s.AUTOSAVE.ass", name.string(),
 			                                     agi::util::strftime("%Y-%m-%d-%H-%M-%S"));
-			SubtitleFormat::GetWriter(path)->WriteFile(subs.get(), path, 0);
+			// Write the snapshot directly rather than copying it to an
+			// AssFile, so that only the lines changed since the last
+			// autosave have to be formatted again
+			AssSubtitleFormat::WriteSnapshot(snapshot, properties, path, *cache);
 			msg = fmt_tl("File backup saved as \"%s\".", path);
 		}
 		catch (const agi::Exception& err) {
@@ -291,6 +681,18 @@ void SubsController::AutoSave() {
 	});
 }
 
+AssFileSnapshot SubsController::GetSnapshot() const {
+	// Nothing has been committed yet, so the undo state is not up to date
+	if (undo_stack.empty())
+		return AssFileSnapshot(*context->ass);
+
+	// Saving drops unused extradata without committing, so that is taken from
+	// the file rather than the undo state. It's rarely more than a few entries.
+	auto snapshot = undo_state->snapshot;
+	snapshot.SetExtradata(context->ass->Extradata);
+	return snapshot;
+}
+
 bool SubsController::CanSave() const {
 	try {
 		return SubtitleFormat::GetWriter(filename)->CanSave(context->ass.get());
@@ -308,24 +710,29 @@ void SubsController::SetFileName(agi::fs::path const& path) {
 }
 
 void SubsController::OnCommit(AssFileCommit c) {
-	if (c.message.empty() && !undo_stack.empty()) return;
+	if (c.message.empty() && !undo_stack.empty()) {
+		// Undo and redo update the undo state themselves before committing
+		assert(undo_state->Matches(context->ass.get()));
+		return;
+	}
 
 	commit_id = next_commit_id++;
 	// Allow coalescing only if it's the last change and the file has not been
 	// saved since the last change
 	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
-		// If only one line changed just modify it instead of copying the file
+		// If only one line changed just update the existing entry rather than
+		// treating this as a new change
 		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
-			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
-					break;
-				}
-			}
+			undo_stack.back().Amend(context->ass.get(), *undo_state, *c.single_line);
+			assert(undo_state->Matches(context->ass.get()));
 			*c.commit_id = commit_id;
 			return;
 		}
 
+		// Otherwise replace the entry with one recorded relative to the state
+		// before it
+		if (!undo_stack.back().base)
+			undo_stack.back().Revert(*undo_state);
 		undo_stack.pop_back();
 	}
 
@@ -339,7 +746,10 @@ void SubsController::OnCommit(AssFileCommit c) {
 
 	redo_stack.clear();
 
-	undo_stack.emplace_back(context, c.message, commit_id);
+	bool base = undo_stack.empty();
+	undo_stack.emplace_back(context, *undo_state, c.message, commit_id, c.type, c.single_line, base);
+	// Everything which is handed the file via GetSnapshot relies on this
+	assert(undo_state->Matches(context->ass.get()));
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
@@ -368,23 +778,25 @@ void SubsController::OnTextSelectionChanged() {
 
 void SubsController::Undo() {
 	if (undo_stack.size() <= 1) return;
+	undo_stack.back().Revert(*undo_state);
 	redo_stack.splice(redo_stack.end(), undo_stack, std::prev(undo_stack.end()));
 
 	commit_id = undo_stack.back().commit_id;
 
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	undo_stack.back().Apply(context, *undo_state);
 	text_selection_connection.Unblock();
 }
 
 void SubsController::Redo() {
 	if (redo_stack.empty()) return;
 	undo_stack.splice(undo_stack.end(), redo_stack, std::prev(redo_stack.end()));
+	undo_stack.back().Reapply(*undo_state);
 
 	commit_id = undo_stack.back().commit_id;
 
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	undo_stack.back().Apply(context, *undo_state);
 	text_selection_connection.Unblock();
 }
 
@@ -20,7 +20,9 @@
 #include <boost/container/list.hpp>
 #include <wx/timer.h>
 
+class AssFileSnapshot;
 class SelectionController;
+struct AssEventTextCache;
 namespace agi {
 	namespace dispatch {
 		class Queue;
@@ -41,6 +43,11 @@ class SubsController : private agi::signal::ConnectionScope {
 	boost::container::list<UndoInfo> undo_stack;
 	boost::container::list<UndoInfo> redo_stack;
 
+	/// Contents of the file as of the top of the undo stack, which the entries
+	/// on the stacks record their changes relative to
+	struct UndoState;
+	std::unique_ptr<UndoState> undo_state;
+
 	/// Revision counter for undo coalescing and modified state tracking
 	int commit_id = 0;
 	/// Last saved version of this file
@@ -57,6 +64,9 @@ class SubsController : private agi::signal::ConnectionScope {
 
 	/// Queue which autosaves are performed on
 	std::unique_ptr<agi::dispatch::Queue> autosave_queue;
+	/// Formatted events from the previous autosave, which is only used on
+	/// the autosave queue
+	std::unique_ptr<AssEventTextCache> autosave_cache;
 
 	/// A new file has been opened (filename)
 	agi::signal::Signal<agi::fs::path> FileOpen;
@@ -114,6 +124,13 @@ public:
 	/// Can the file be saved in its current format?
 	bool CanSave() const;
 
+	/// Get a snapshot of the file as of the most recent commit
+	///
+	/// This is cheap to make and shares its contents with the subtitles
+	/// controller's own copy, so it is the preferred way to hand the file off
+	/// to something running on another thread.
+	AssFileSnapshot GetSnapshot() const;
+
 	/// The file is about to be saved
 	/// This signal is intended for adding metadata which is awkward or
 	/// expensive to always keep up to date
@@ -20,6 +20,7 @@
 #include "ass_dialogue.h"
 #include "ass_info.h"
 #include "ass_file.h"
+#include "ass_file_snapshot.h"
 #include "ass_style.h"
 #include "ass_parser.h"
 #include "options.h"
@@ -29,15 +30,29 @@
 
 #include <libaegisub/ass/string_codec.h>
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/fs.h>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <span>
+
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 
 void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const&, const char *encoding) const {
 	int version = !agi::fs::HasExtension(filename, "ssa");
 
-	TextFileReader file(filename, encoding);
 	AssParser parser(target, version);
+
+	// UTF-8 files can be parsed straight out of the file mapping without
+	// copying each line out of it
+	if (boost::iequals(std::string_view(encoding), "utf-8")) {
+		agi::read_file_mapping file(filename);
+		parser.AddFile(std::string_view(file.read(), file.size()));
+		return;
+	}
+
+	TextFileReader file(filename, encoding);
 	while (file.HasMoreLines())
 		parser.AddLine(file.ReadLineFromFile());
 }
@@ -57,39 +72,117 @@ const char *format(AssEntryGroup group) {
 	return nullptr;
 }
 
+/// Number of lines formatted by each task when formatting events in parallel
+constexpr size_t event_block_size = 256;
+
+void AppendEvents(std::string &out, std::span<const AssDialogueBase> lines) {
+	for (auto const& line : lines) {
+		line.AppendEntryData(out);
+		out += LINEBREAK;
+	}
+}
+
 struct Writer {
 	TextFileWriter file;
+	/// The file is formatted into these and then written all at once
+	std::vector<std::string> blocks;
+	/// The block currently being appended to
+	std::string buffer;
 	AssEntryGroup group = AssEntryGroup::INFO;
 
 	Writer(agi::fs::path const& filename, std::string const& encoding)
 	: file(filename, encoding)
 	{
-		file.WriteLineToFile("[Script Info]");
-		file.WriteLineToFile(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
-		file.WriteLineToFile("; https://aegisub.org/");
+		WriteLine("[Script Info]");
+		WriteLine(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
+		WriteLine("; https://aegisub.org/");
+	}
+
+	void WriteLine(std::string_view line) {
+		buffer += line;
+		buffer += LINEBREAK;
+	}
+
+	void BeginGroup(AssEntryGroup new_group, std::string const& header) {
+		if (new_group == group) return;
+
+		// Add a blank line between each group
+		WriteLine("");
+
+		WriteLine(header);
+		if (const char *str = format(new_group))
+			buffer += str;
+
+		group = new_group;
 	}
 
 	template<typename T>
 	void Write(T const& list) {
 		for (auto const& line : list) {
-			if (line.Group() != group) {
-				// Add a blank line between each group
-				file.WriteLineToFile("");
+			BeginGroup(line.Group(), line.GroupHeader());
+			WriteLine(line.GetEntryData());
+		}
+	}
+
+	/// Add already-formatted blocks of text after what has been written so far
+	void AppendBlocks(std::vector<std::string>&& formatted) {
+		blocks.push_back(std::move(buffer));
+		for (auto& block : formatted)
+			blocks.push_back(std::move(block));
+		buffer.clear();
+	}
+
+	void Write(EntryList<AssDialogue> const& events) {
+		if (events.empty()) return;
+		BeginGroup(AssEntryGroup::DIALOGUE, events.front().GroupHeader());
 
-				file.WriteLineToFile(line.GroupHeader());
-				if (const char *str = format(line.Group()))
-					file.WriteLineToFile(str, false);
+		std::vector<const AssDialogue *> lines;
+		lines.reserve(events.size());
+		for (auto const& line : events)
+			lines.push_back(&line);
 
-				group = line.Group();
+		std::vector<std::string> formatted((lines.size() + event_block_size - 1) / event_block_size);
+		agi::dispatch::ParallelFor(formatted.size(), [&](size_t i) {
+			auto end = std::min(lines.size(), (i + 1) * event_block_size);
+			for (size_t j = i * event_block_size; j < end; ++j) {
+				lines[j]->AppendEntryData(formatted[i]);
+				formatted[i] += LINEBREAK;
 			}
+		});
+		AppendBlocks(std::move(formatted));
+	}
+
+	void Write(AssFileSnapshot::EventChunks const& chunks, AssEventTextCache &cache) {
+		if (chunks.empty()) return;
+		BeginGroup(AssEntryGroup::DIALOGUE, "[Events]");
 
-			file.WriteLineToFile(line.GetEntryData());
+		// Chunks are immutable, so any chunk which is still alive and was in
+		// the previous snapshot written has the same text as it did then
+		std::vector<std::string> formatted(chunks.size());
+		std::vector<size_t> changed;
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			auto it = cache.chunks.find(chunks[i].get());
+			if (it == cache.chunks.end() || it->second.chunk.lock() != chunks[i])
+				changed.push_back(i);
+			else
+				formatted[i] = std::move(it->second.text);
 		}
+
+		agi::dispatch::ParallelFor(changed.size(), [&](size_t i) {
+			AppendEvents(formatted[changed[i]], *chunks[changed[i]]);
+		});
+
+		decltype(cache.chunks) updated;
+		updated.reserve(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i)
+			updated[chunks[i].get()] = {chunks[i], formatted[i]};
+		cache.chunks = std::move(updated);
+		AppendBlocks(std::move(formatted));
 	}
 
 	void Write(ProjectProperties const& properties) {
-		file.WriteLineToFile("");
-		file.WriteLineToFile("[Aegisub Project Garbage]");
+		WriteLine("");
+		WriteLine("[Aegisub Project Garbage]");
 
 		WriteIfNotEmpty("Automation Scripts: ", properties.automation_scripts);
 		WriteIfNotEmpty("Export Filters: ", properties.export_filters);
@@ -113,13 +206,13 @@ struct Writer {
 
 	void WriteIfNotEmpty(const char *key, std::string const& value) {
 		if (!value.empty())
-			file.WriteLineToFile(key + value);
+			WriteLine(key + value);
 	}
 
 	template<typename Number>
 	void WriteIfNotZero(const char *key, Number n) {
 		if (n != Number{})
-			file.WriteLineToFile(key + std::to_string(n));
+			WriteLine(key + std::to_string(n));
 	}
 
 	void WriteExtradata(std::vector<ExtradataEntry> const& extradata) {
@@ -127,8 +220,8 @@ struct Writer {
 			return;
 
 		group = AssEntryGroup::EXTRADATA;
-		file.WriteLineToFile("");
-		file.WriteLineToFile("[Aegisub Extradata]");
+		WriteLine("");
+		WriteLine("[Aegisub Extradata]");
 		for (auto const& edi : extradata) {
 			std::string line = "Data: ";
 			line += std::to_string(edi.id);
@@ -145,9 +238,16 @@ struct Writer {
 				line += "e"; // marker for inline_string encoding (escaping)
 				line += encoded_data;
 			}
-			file.WriteLineToFile(line);
+			WriteLine(line);
 		}
 	}
+
+	/// Write everything to the file
+	void Finish() {
+		for (auto const& block : blocks)
+			file.WriteLineToFile(block, false);
+		file.WriteLineToFile(buffer, false);
+	}
 };
 }
 
@@ -159,6 +259,23 @@ void AssSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
 	writer.WriteExtradata(src->Extradata);
+	writer.Finish();
+}
+
+void AssSubtitleFormat::WriteSnapshot(AssFileSnapshot const& snapshot, ProjectProperties const& properties, agi::fs::path const& filename, AssEventTextCache &cache) {
+	std::vector<AssInfo> info;
+	info.reserve(snapshot.GetScriptInfo().size());
+	for (auto const& line : snapshot.GetScriptInfo())
+		info.emplace_back(line.first, line.second);
+
+	Writer writer(filename, "");
+	writer.Write(info);
+	writer.Write(properties);
+	writer.Write(snapshot.GetStyles());
+	writer.Write(snapshot.GetAttachments());
+	writer.Write(snapshot.GetEventChunks(), cache);
+	writer.WriteExtradata(snapshot.GetExtradata());
+	writer.Finish();
 }
 
 void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const&, const char *encoding) const {
@@ -167,4 +284,5 @@ void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& file
 	writer.Write(src->Styles);
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
+	writer.Finish();
 }
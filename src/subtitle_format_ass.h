@@ -16,6 +16,28 @@
 
 #include "subtitle_format.h"
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class AssFileSnapshot;
+struct ProjectProperties;
+
+/// @class AssEventTextCache
+/// @brief The formatted events of each node of the snapshots written by
+///        AssSubtitleFormat::WriteSnapshot
+///
+/// Nodes of snapshots are immutable and shared between snapshots, so only
+/// the nodes which are new since the last write need to be formatted again.
+struct AssEventTextCache {
+	struct Entry {
+		/// The node, to tell if the address has been reused by a new one
+		std::weak_ptr<const void> chunk;
+		std::string text;
+	};
+	std::unordered_map<const void *, Entry> chunks;
+};
+
 class AssSubtitleFormat final : public SubtitleFormat {
 public:
 	AssSubtitleFormat() : SubtitleFormat("Advanced SubStation Alpha") { }
@@ -29,6 +51,17 @@ public:
 	void ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, const char *forceEncoding) const override;
 	void WriteFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, const char *encoding) const override;
 
+	/// @brief Write a snapshot of a file in the default encoding
+	/// @param snapshot   File to write
+	/// @param properties Project properties to write with it
+	/// @param filename   File to write to
+	/// @param cache      Text of the events from previous writes with the
+	///                   same cache, which is updated to the new snapshot
+	///
+	/// This is used for autosaving, which happens in the background and so
+	/// can't use the AssFile.
+	static void WriteSnapshot(AssFileSnapshot const& snapshot, ProjectProperties const& properties, agi::fs::path const& filename, AssEventTextCache &cache);
+
 	// Does not write [Aegisub Project Garbage] and [Aegisub Extradata] sections when exporting
 	void ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, const char *encoding) const override;
 };
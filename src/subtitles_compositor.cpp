@@ -0,0 +1,143 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file subtitles_compositor.cpp
+/// @brief Blending of rendered subtitles into video frames
+/// @ingroup subtitle_rendering
+
+#include "subtitles_compositor.h"
+
+#include "video_frame.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+/// floor(v / 255) for v in [0, 255 * 255]
+inline unsigned div255(unsigned v) {
+	return (v + 1 + (v >> 8)) >> 8;
+}
+
+#ifdef AGI_COMPOSITOR_SSE2
+/// div255 for each 16-bit lane
+inline __m128i div255_epu16(__m128i v) {
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_set1_epi16(1)), _mm_srli_epi16(v, 8)), 8);
+}
+#endif
+
+/// Blend one row of w pixels
+/// @param dst     BGRA pixels
+/// @param mask    Coverage of each pixel
+/// @param opacity Opacity of the colour, 0-255
+/// @param channel Colour to blend in each channel, in BGRA order
+/// @param alpha   Mask to apply to the alpha channel of the result
+void BlendRow(uint8_t *dst, const uint8_t *mask, int w, unsigned opacity, const uint8_t channel[4], uint8_t alpha) {
+	int x = 0;
+
+#ifdef AGI_COMPOSITOR_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i v255 = _mm_set1_epi16(255);
+	const __m128i vopacity = _mm_set1_epi16(static_cast<short>(opacity));
+	const __m128i vchannel = _mm_setr_epi16(channel[0], channel[1], channel[2], channel[3],
+	                                        channel[0], channel[1], channel[2], channel[3]);
+	const __m128i valpha = _mm_setr_epi8(-1, -1, -1, static_cast<char>(alpha), -1, -1, -1, static_cast<char>(alpha),
+	                                     -1, -1, -1, static_cast<char>(alpha), -1, -1, -1, static_cast<char>(alpha));
+
+	for (; x + 4 <= w; x += 4) {
+		uint32_t coverage;
+		memcpy(&coverage, mask + x, 4);
+		if (!coverage) continue;
+
+		// Per-pixel weight, then each repeated for the four channels
+		__m128i k = _mm_cvtsi32_si128(static_cast<int>(coverage));
+		k = _mm_unpacklo_epi8(k, zero);
+		// Uncovered pixels keep their alpha like in the scalar loop
+		__m128i uncovered = _mm_cmpeq_epi32(_mm_unpacklo_epi16(k, zero), zero);
+		k = div255_epu16(_mm_mullo_epi16(k, vopacity));
+		k = _mm_unpacklo_epi16(k, k);
+		__m128i k_lo = _mm_unpacklo_epi32(k, k);
+		__m128i k_hi = _mm_unpackhi_epi32(k, k);
+
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x * 4));
+		__m128i d_lo = _mm_unpacklo_epi8(pixels, zero);
+		__m128i d_hi = _mm_unpackhi_epi8(pixels, zero);
+
+		d_lo = div255_epu16(_mm_add_epi16(_mm_mullo_epi16(k_lo, vchannel), _mm_mullo_epi16(_mm_sub_epi16(v255, k_lo), d_lo)));
+		d_hi = div255_epu16(_mm_add_epi16(_mm_mullo_epi16(k_hi, vchannel), _mm_mullo_epi16(_mm_sub_epi16(v255, k_hi), d_hi)));
+
+		pixels = _mm_and_si128(_mm_packus_epi16(d_lo, d_hi), _mm_or_si128(valpha, uncovered));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), pixels);
+	}
+#endif
+
+	for (; x < w; ++x) {
+		if (!mask[x]) continue;
+		unsigned k = div255(mask[x] * opacity);
+		uint8_t *px = dst + x * 4;
+		for (int c = 0; c < 4; ++c)
+			px[c] = static_cast<uint8_t>(div255(k * channel[c] + (255 - k) * px[c]));
+		px[3] &= alpha;
+	}
+}
+}
+
+void BlendSubtitleMask(VideoFrame &dst, const uint8_t *mask, ptrdiff_t stride,
+	int x, int y, int w, int h, uint32_t color, SubtitleBlendMode mode)
+{
+	// Clip to the frame
+	int left = std::max(0, -x), top = std::max(0, -y);
+	int right = std::min(w, dst.width - x), bottom = std::min(h, dst.height - y);
+	if (left >= right || top >= bottom) return;
+
+	const unsigned opacity = 255 - (color & 0xFF);
+	if (!opacity) return;
+
+	// In overlay mode, alpha is composited like any other channel with a
+	// "colour" of fully opaque, which gives premultiplied over compositing
+	const bool overlay = mode == SubtitleBlendMode::Overlay;
+	const uint8_t channel[4] = {
+		static_cast<uint8_t>(color >> 8),
+		static_cast<uint8_t>(color >> 16),
+		static_cast<uint8_t>(color >> 24),
+		static_cast<uint8_t>(overlay ? 255 : 0)
+	};
+	const uint8_t alpha = overlay ? 0xFF : 0;
+
+	for (int row = top; row < bottom; ++row) {
+		int frame_row = y + row;
+		if (dst.flipped)
+			frame_row = dst.height - 1 - frame_row;
+		uint8_t *dst_row = dst.data.data() + static_cast<ptrdiff_t>(frame_row) * dst.pitch + static_cast<ptrdiff_t>(x + left) * 4;
+		BlendRow(dst_row, mask + row * stride + left, right - left, opacity, channel, alpha);
+	}
+}
+
+void UnpremultiplyFrame(VideoFrame &frame) {
+	for (int y = 0; y < frame.height; ++y) {
+		uint8_t *px = frame.data.data() + static_cast<ptrdiff_t>(y) * frame.pitch;
+		for (int x = 0; x < frame.width; ++x, px += 4) {
+			unsigned a = px[3];
+			if (a == 0 || a == 255) continue;
+			for (int c = 0; c < 3; ++c)
+				px[c] = static_cast<uint8_t>(std::min(255u, (px[c] * 255 + a / 2) / a));
+		}
+	}
+}
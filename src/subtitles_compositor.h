@@ -0,0 +1,54 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file subtitles_compositor.h
+/// @brief Blending of rendered subtitles into video frames
+/// @ingroup subtitle_rendering
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct VideoFrame;
+
+/// How BlendSubtitleMask treats the destination frame
+enum class SubtitleBlendMode {
+	/// Blend onto video, leaving the alpha channel zeroed where drawn
+	Frame,
+	/// Composite onto a premultiplied BGRA overlay, which should start out
+	/// fully transparent
+	Overlay
+};
+
+/// @brief Blend a single-coloured, alpha-masked image into a frame
+/// @param dst    Frame to draw on
+/// @param mask   Coverage of each pixel, 255 for fully covered
+/// @param stride Bytes between the rows of mask
+/// @param x      Left edge of the image in the frame
+/// @param y      Top edge of the image in the frame
+/// @param w      Width of the image
+/// @param h      Height of the image
+/// @param color  Colour in 0xRRGGBBTT form, where TT is the transparency
+/// @param mode   How to treat the frame
+///
+/// This is the form libass produces its output in. Only the pixels covered
+/// by the image are touched, and the image is clipped to the frame.
+void BlendSubtitleMask(VideoFrame &dst, const uint8_t *mask, ptrdiff_t stride,
+	int x, int y, int w, int h, uint32_t color, SubtitleBlendMode mode);
+
+/// Convert a premultiplied BGRA frame to straight alpha
+void UnpremultiplyFrame(VideoFrame &frame);
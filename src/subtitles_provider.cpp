@@ -25,6 +25,9 @@
 #include "options.h"
 #include "subtitles_provider_csri.h"
 #include "subtitles_provider_libass.h"
+#include "video_frame.h"
+
+#include <algorithm>
 
 namespace {
 	struct factory {
@@ -99,10 +102,31 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	}
 
 	push_header("[Events]\n");
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
-			push_line(line.GetEntryData());
+	if (time < 0) {
+		for (auto const& line : subs->Events) {
+			if (!line.Comment)
+				push_line(line.GetEntryData());
+		}
+	}
+	else {
+		for (auto line : subs->TimeIndex.At(time)) {
+			if (!line->Comment)
+				push_line(line->GetEntryData());
+		}
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
 }
+
+void SubtitlesProvider::DrawOverlay(VideoFrame &dst, double time) {
+	// Draw the subtitles once on black and once on white. For a pixel with
+	// colour c and alpha a, black gives c * a and white gives c * a + 255 - a,
+	// so the black frame is already the premultiplied colour.
+	VideoFrame white = dst;
+	std::fill(white.data.begin(), white.data.end(), 255);
+	DrawSubtitles(dst, time);
+	DrawSubtitles(white, time);
+
+	for (size_t i = 0; i + 3 < dst.data.size(); i += 4)
+		dst.data[i + 3] = static_cast<unsigned char>(255 - (white.data[i] - dst.data[i]));
+}
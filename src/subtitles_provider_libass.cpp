@@ -34,8 +34,13 @@
 
 #include "subtitles_provider_libass.h"
 
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_style.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "subtitles_compositor.h"
 #include "video_frame.h"
 
 #include <libaegisub/background_runner.h>
@@ -44,10 +49,13 @@
 #include <libaegisub/log.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <atomic>
-#include <boost/gil.hpp>
+#include <boost/container_hash/hash.hpp>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -75,6 +83,35 @@ void msg_callback(int level, const char *fmt, va_list args, void *) {
 		LOG_D("subtitle/provider/libass") << buf;
 }
 
+/// Hash of the fields of a line which affect how it is rendered. The
+/// flyweighted fields are hashed by address, which is unique per value for as
+/// long as a line referring to it exists.
+size_t hash_event(AssDialogueBase const& line) {
+	size_t seed = 0;
+	boost::hash_combine(seed, line.Layer);
+	boost::hash_combine(seed, line.Margin[0]);
+	boost::hash_combine(seed, line.Margin[1]);
+	boost::hash_combine(seed, line.Margin[2]);
+	boost::hash_combine(seed, static_cast<int>(line.Start));
+	boost::hash_combine(seed, static_cast<int>(line.End));
+	boost::hash_combine(seed, &line.Style.get());
+	boost::hash_combine(seed, &line.Actor.get());
+	boost::hash_combine(seed, &line.Effect.get());
+	boost::hash_combine(seed, &line.Text.get());
+	return seed;
+}
+
+bool same_event(AssDialogueBase const& a, AssDialogueBase const& b) {
+	return a.Layer == b.Layer
+		&& a.Margin == b.Margin
+		&& a.Start == b.Start
+		&& a.End == b.End
+		&& a.Style == b.Style
+		&& a.Actor == b.Actor
+		&& a.Effect == b.Effect
+		&& a.Text == b.Text;
+}
+
 // Stuff used on the cache thread, owned by a shared_ptr in case the provider
 // gets deleted before the cache finishing updating
 struct cache_thread_shared {
@@ -88,6 +125,37 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track* ass_track = nullptr;
 
+	/// Do the members below accurately describe the contents of ass_track?
+	bool track_valid = false;
+	/// Lines loaded into the track, with loaded_events[i] being the source of
+	/// ass_track->events[i]
+	std::vector<AssDialogueBase> loaded_events;
+	/// Index into loaded_events for each row of the file, or -1 for comments
+	std::vector<int> row_events;
+	/// Name and entry data of each style in the file
+	std::vector<std::pair<std::string, std::string>> loaded_styles;
+	/// Index in ass_track->styles of the first style from the file, as libass
+	/// may add a default style of its own before them
+	int style_offset = 0;
+	/// Font attachments which have been passed to libass. The copies are held
+	/// on to so that the addresses in loaded_font_data remain unique.
+	std::vector<AssAttachment> loaded_fonts;
+	std::unordered_set<std::string const*> loaded_font_data;
+
+	/// Throw away the track and load the entire file
+	void LoadFull(AssFile *subs);
+	/// Feed some more data to the track's parser
+	void ProcessData(std::string data);
+	/// Apply changes to the styles, if possible without reparsing the events
+	void UpdateStyles(AssFile *subs);
+	/// Load any font attachments which have been added
+	void UpdateFonts(AssFile *subs);
+	/// Replace the event for a single modified line
+	/// @return Was the change handled?
+	bool UpdateLine(AssDialogue const& line);
+	/// Drop events for lines which no longer exist and add the new and modified ones
+	void UpdateEvents(AssFile *subs);
+
 	ASS_Renderer *renderer() {
 		if (shared->ready)
 			return shared->renderer;
@@ -119,12 +187,19 @@ public:
 	~LibassSubtitlesProvider();
 
 	void LoadSubtitles(const char *data, size_t len) override {
+		track_valid = false;
 		if (ass_track) ass_free_track(ass_track);
 		ass_track = ass_read_memory(library, const_cast<char *>(data), len, nullptr);
 		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
 	}
 
+	bool UpdateSubtitles(AssFile *subs, int type, const AssDialogue *changed) override;
+
+	/// Render the frame at the given time, returning libass's image list
+	ASS_Image *Render(VideoFrame &frame, double time);
+
 	void DrawSubtitles(VideoFrame &dst, double time) override;
+	void DrawOverlay(VideoFrame &dst, double time) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
@@ -158,49 +233,262 @@ LibassSubtitlesProvider::~LibassSubtitlesProvider() {
 	if (ass_track) ass_free_track(ass_track);
 }
 
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
+void LibassSubtitlesProvider::LoadFull(AssFile *subs) {
+	SubtitlesProvider::LoadSubtitles(subs);
 
-void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
+	loaded_events.clear();
+	row_events.clear();
+	row_events.reserve(subs->Events.size());
+	for (auto const& line : subs->Events) {
+		row_events.push_back(line.Comment ? -1 : static_cast<int>(loaded_events.size()));
+		if (!line.Comment)
+			loaded_events.push_back(line);
+	}
+
+	loaded_styles.clear();
+	for (auto const& style : subs->Styles)
+		loaded_styles.emplace_back(style.name, style.GetEntryData());
+	style_offset = ass_track->n_styles - static_cast<int>(loaded_styles.size());
+
+	loaded_fonts.clear();
+	loaded_font_data.clear();
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() == AssEntryGroup::FONT) {
+			loaded_fonts.push_back(attachment);
+			loaded_font_data.insert(&attachment.GetEntryData());
+		}
+	}
+
+	// libass silently drops lines which it fails to parse, after which the
+	// indices no longer line up and only full reloads are possible
+	track_valid = ass_track->n_events == static_cast<int>(loaded_events.size()) && style_offset >= 0;
+}
+
+void LibassSubtitlesProvider::ProcessData(std::string data) {
+	ass_process_data(ass_track, &data[0], static_cast<int>(data.size()));
+}
+
+void LibassSubtitlesProvider::UpdateStyles(AssFile *subs) {
+	// Events refer to their style by index, so styles can only be replaced in
+	// place if none were added, removed, renamed or reordered
+	std::vector<size_t> changed;
+	std::string data = "[V4+ Styles]\n";
+	size_t i = 0;
+	for (auto const& style : subs->Styles) {
+		if (i >= loaded_styles.size() || style.name != loaded_styles[i].first) {
+			track_valid = false;
+			return;
+		}
+		if (style.GetEntryData() != loaded_styles[i].second) {
+			changed.push_back(i);
+			loaded_styles[i].second = style.GetEntryData();
+			data += style.GetEntryData();
+			data += '\n';
+		}
+		++i;
+	}
+	if (i != loaded_styles.size()) {
+		track_valid = false;
+		return;
+	}
+	if (changed.empty()) return;
+
+	int first_new = ass_track->n_styles;
+	ProcessData(data + "[Events]\n");
+	if (ass_track->n_styles != first_new + static_cast<int>(changed.size())) {
+		track_valid = false;
+		return;
+	}
+
+	// Move the newly parsed styles into the slots of the ones they replace
+	for (size_t j = 0; j < changed.size(); ++j) {
+		int sid = first_new + static_cast<int>(j);
+		int slot = style_offset + static_cast<int>(changed[j]);
+		ass_free_style(ass_track, slot);
+		ass_track->styles[slot] = ass_track->styles[sid];
+		if (ass_track->default_style == sid)
+			ass_track->default_style = slot;
+	}
+	ass_track->n_styles = first_new;
+}
+
+void LibassSubtitlesProvider::UpdateFonts(AssFile *subs) {
+	// libass has no way to unload a single font, so removed attachments simply
+	// stay loaded just as they would with a full reload
+	std::string data = "[Fonts]\n";
+	size_t loaded = loaded_fonts.size();
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() != AssEntryGroup::FONT) continue;
+		if (!loaded_font_data.insert(&attachment.GetEntryData()).second) continue;
+		loaded_fonts.push_back(attachment);
+		data += attachment.GetEntryData();
+		data += '\n';
+	}
+
+	if (loaded_fonts.size() != loaded)
+		ProcessData(data + "[Events]\n");
+}
+
+bool LibassSubtitlesProvider::UpdateLine(AssDialogue const& line) {
+	if (line.Row < 0 || static_cast<size_t>(line.Row) >= row_events.size())
+		return false;
+
+	// Lines being commented or uncommented change which events exist
+	int idx = row_events[line.Row];
+	if (idx < 0 || line.Comment)
+		return idx < 0 && line.Comment;
+
+	if (same_event(loaded_events[idx], line))
+		return true;
+
+	int eid = ass_track->n_events;
+	ProcessData("[Events]\n" + line.GetEntryData() + "\n");
+	if (ass_track->n_events != eid + 1)
+		return false;
+
+	int read_order = ass_track->events[idx].ReadOrder;
+	ass_free_event(ass_track, idx);
+	ass_track->events[idx] = ass_track->events[eid];
+	ass_track->events[idx].ReadOrder = read_order;
+	--ass_track->n_events;
+	loaded_events[idx] = line;
+	return true;
+}
+
+void LibassSubtitlesProvider::UpdateEvents(AssFile *subs) {
+	// Index the loaded events by content so that lines which are unchanged
+	// (or merely moved) can keep their already-parsed events
+	std::unordered_multimap<size_t, int> unused;
+	unused.reserve(loaded_events.size());
+	for (size_t i = 0; i < loaded_events.size(); ++i)
+		unused.emplace(hash_event(loaded_events[i]), static_cast<int>(i));
+
+	// For each existing event, its position in the new file or -1 to drop it
+	std::vector<int> kept_position(loaded_events.size(), -1);
+	// For each row, the existing event to reuse, -1 for comments, or -2 - n
+	// for the nth added line
+	std::vector<int> row_source;
+	row_source.reserve(subs->Events.size());
+	std::vector<AssDialogue const*> added;
+	std::vector<int> added_position;
+	std::string data = "[Events]\n";
+
+	int position = 0;
+	for (auto const& line : subs->Events) {
+		if (line.Comment) {
+			row_source.push_back(-1);
+			continue;
+		}
+
+		auto range = unused.equal_range(hash_event(line));
+		auto it = std::find_if(range.first, range.second, [&](auto const& p) {
+			return same_event(loaded_events[p.second], line);
+		});
+		if (it != range.second) {
+			kept_position[it->second] = position;
+			row_source.push_back(it->second);
+			unused.erase(it);
+		}
+		else {
+			row_source.push_back(-2 - static_cast<int>(added.size()));
+			added.push_back(&line);
+			added_position.push_back(position);
+			data += line.GetEntryData();
+			data += '\n';
+		}
+		++position;
+	}
+
+	// Free the stale events and compact the remaining ones, remembering where
+	// each of them ended up
+	std::vector<int> new_index(loaded_events.size(), -1);
+	std::vector<AssDialogueBase> events;
+	events.reserve(position);
+	int count = 0;
+	for (size_t i = 0; i < loaded_events.size(); ++i) {
+		if (kept_position[i] < 0) {
+			ass_free_event(ass_track, static_cast<int>(i));
+			continue;
+		}
+		if (count != static_cast<int>(i))
+			ass_track->events[count] = ass_track->events[i];
+		ass_track->events[count].ReadOrder = kept_position[i];
+		events.push_back(std::move(loaded_events[i]));
+		new_index[i] = count++;
+	}
+	ass_track->n_events = count;
+
+	if (!added.empty()) {
+		ProcessData(std::move(data));
+		if (ass_track->n_events != count + static_cast<int>(added.size())) {
+			track_valid = false;
+			return;
+		}
+		for (size_t i = 0; i < added.size(); ++i) {
+			ass_track->events[count + i].ReadOrder = added_position[i];
+			events.push_back(*added[i]);
+		}
+	}
+
+	row_events.clear();
+	row_events.reserve(row_source.size());
+	for (int source : row_source) {
+		if (source == -1)
+			row_events.push_back(-1);
+		else if (source >= 0)
+			row_events.push_back(new_index[source]);
+		else
+			row_events.push_back(count - 2 - source);
+	}
+
+	loaded_events = std::move(events);
+}
+
+bool LibassSubtitlesProvider::UpdateSubtitles(AssFile *subs, int type, const AssDialogue *changed) {
+	// Script info changes can alter how everything is rendered and new files
+	// share nothing with the old track, so both need a full reload
+	if (type == AssFile::COMMIT_NEW || (type & AssFile::COMMIT_SCRIPTINFO))
+		track_valid = false;
+
+	if (track_valid) {
+		if (type & AssFile::COMMIT_STYLES)
+			UpdateStyles(subs);
+		if (track_valid && (type & AssFile::COMMIT_ATTACHMENT))
+			UpdateFonts(subs);
+		if (track_valid && (type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_FULL))) {
+			bool only_line = changed && !(type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_ORDER));
+			if (!only_line || !UpdateLine(*changed))
+				UpdateEvents(subs);
+		}
+	}
+
+	if (!track_valid)
+		LoadFull(subs);
+	return true;
+}
+
+ASS_Image *LibassSubtitlesProvider::Render(VideoFrame &frame, double time) {
 	ass_set_frame_size(renderer(), frame.width, frame.height);
 	// Note: this relies on Aegisub always rendering at video storage res
 	ass_set_storage_size(renderer(), frame.width, frame.height);
 
 	// Add 1e-6 to guard against floating point imprecision errors on int -> float -> *1000 -> int round trips
-	ASS_Image* img = ass_render_frame(renderer(), ass_track, floor(time * 1000 + 1e-6), nullptr);
+	return ass_render_frame(renderer(), ass_track, floor(time * 1000 + 1e-6), nullptr);
+}
 
+void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
 	// libass actually returns several alpha-masked monochrome images.
-	// Here, we loop through their linked list, get the colour of the current, and blend into the frame.
-	// This is repeated for all of them.
-
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
-
-	for (; img; img = img->next) {
-		unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-		unsigned int r = (unsigned int)_r(img->color);
-		unsigned int g = (unsigned int)_g(img->color);
-		unsigned int b = (unsigned int)_b(img->color);
-
-		auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-		auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-		transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame, const gray8_pixel_t src) -> bgra8_pixel_t {
-			unsigned int k = ((unsigned)src) * opacity / 255;
-			unsigned int ck = 255 - k;
-
-			bgra8_pixel_t ret;
-			ret[0] = (k * b + ck * frame[0]) / 255;
-			ret[1] = (k * g + ck * frame[1]) / 255;
-			ret[2] = (k * r + ck * frame[2]) / 255;
-			ret[3] = 0;
-			return ret;
-		});
-	}
+	// Here, we loop through their linked list and blend each into the
+	// rectangle of the frame it covers.
+	for (ASS_Image *img = Render(frame, time); img; img = img->next)
+		BlendSubtitleMask(frame, img->bitmap, img->stride, img->dst_x, img->dst_y,
+			img->w, img->h, img->color, SubtitleBlendMode::Frame);
+}
+
+void LibassSubtitlesProvider::DrawOverlay(VideoFrame &frame, double time) {
+	for (ASS_Image *img = Render(frame, time); img; img = img->next)
+		BlendSubtitleMask(frame, img->bitmap, img->stride, img->dst_x, img->dst_y,
+			img->w, img->h, img->color, SubtitleBlendMode::Overlay);
 }
 }
 
@@ -41,6 +41,7 @@
 #include <unistd.h>
 #endif
 #include <algorithm>
+#include <charconv>
 #include <map>
 #include <unicode/locid.h>
 #include <unicode/unistr.h>
@@ -76,14 +77,22 @@ wxString PrettySize(int bytes) {
 }
 
 std::string float_to_string(double val, int precision) {
-	std::string fmt = "%." + std::to_string(precision) + "f";
-	std::string s = agi::format(fmt, val);
-	size_t pos = s.find_last_not_of("0");
-	if (pos != s.find(".")) ++pos;
-	s.erase(begin(s) + pos, end(s));
+	std::string s;
+	append_float_string(s, val, precision);
 	return s;
 }
 
+void append_float_string(std::string &out, double val, int precision) {
+	char buf[512];
+	auto res = std::to_chars(buf, std::end(buf), val, std::chars_format::fixed, precision);
+	std::string_view s(buf, res.ec == std::errc() ? res.ptr - buf : 0);
+
+	// Strip trailing zeros, and the decimal point if nothing is left after it
+	size_t pos = s.find_last_not_of('0');
+	if (pos != s.find('.')) ++pos;
+	out.append(s.substr(0, pos));
+}
+
 int SmallestPowerOf2(int x) {
 	x--;
 	x |= (x >> 1);
@@ -47,6 +47,8 @@ class wxWindow;
 wxString PrettySize(int bytes);
 
 std::string float_to_string(double val, int precision = 3);
+/// Append float_to_string(val, precision) to out without any temporary strings
+void append_float_string(std::string &out, double val, int precision = 3);
 
 /// @brief Get the smallest power of two that is greater or equal to x
 ///
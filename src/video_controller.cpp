@@ -31,6 +31,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_file_snapshot.h"
 #include "audio_controller.h"
 #include "compat.h"
 #include "format.h"
@@ -38,6 +39,7 @@
 #include "options.h"
 #include "project.h"
 #include "selection_controller.h"
+#include "subs_controller.h"
 #include "time_range.h"
 #include "async_video_provider.h"
 #include "utils.h"
@@ -78,9 +80,14 @@ void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
 	}
 
 	if (!changed)
-		provider->LoadSubtitles(context->ass.get());
+		provider->UpdateSubtitles(context->subsController->GetSnapshot(), type);
 	else
-		provider->UpdateSubtitles(changed);
+		provider->UpdateSubtitles(changed, type);
+}
+
+void VideoController::PreviewLines(std::vector<const AssDialogue *> const& lines, std::chrono::steady_clock::time_point changed_at) {
+	if (provider)
+		provider->UpdateSubtitles(lines, AssFile::COMMIT_DIAG_TEXT, changed_at);
 }
 
 void VideoController::OnActiveLineChanged(AssDialogue *line) {
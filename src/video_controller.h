@@ -157,6 +157,15 @@ public:
 	/// Stop playing
 	void Stop();
 
+	/// @brief Show uncommitted changes to lines on the video
+	/// @param lines      Lines which have been modified in place
+	/// @param changed_at When the oldest of the changes was made
+	///
+	/// This is for changes which are still in progress, such as a visual tool
+	/// drag, and only updates the video. The changes still have to be
+	/// committed once they're done.
+	void PreviewLines(std::vector<const AssDialogue *> const& lines, std::chrono::steady_clock::time_point changed_at);
+
 	DEFINE_SIGNAL_ADDERS(Seek, AddSeekListener)
 	DEFINE_SIGNAL_ADDERS(ARChange, AddARChangeListener)
 
@@ -179,6 +179,8 @@ bool VideoDisplay::InitContext() {
 
 void VideoDisplay::UploadFrameData(FrameReadyEvent &evt) {
 	pending_frame = evt.frame;
+	if (!pending_changed_at)
+		pending_changed_at = evt.changed_at;
 	Render();
 }
 
@@ -246,6 +248,13 @@ void VideoDisplay::Render() try {
 		tool->Draw();
 
 	SwapBuffers();
+
+	if (pending_changed_at) {
+		using namespace std::chrono;
+		LOG_D("video/display") << "Edit to display latency: "
+			<< duration_cast<microseconds>(steady_clock::now() - *pending_changed_at).count() << "us";
+		pending_changed_at.reset();
+	}
 }
 catch (const agi::Exception &err) {
 	wxLogError(
@@ -602,6 +611,10 @@ void VideoDisplay::SetWindowZoomFromBoxText(wxCommandEvent &) {
 }
 
 void VideoDisplay::SetTool(std::unique_ptr<VisualToolBase> new_tool) {
+	// Switching tools in the middle of a drag mustn't lose what was dragged
+	if (tool)
+		tool->FinishPreview();
+
 	// Set the tool first to prevent repeated initialization from VideoDisplay::Render
 	tool = std::move(new_tool);
 
@@ -37,7 +37,9 @@
 #include "vector2d.h"
 #include "visual_tool_vector_clip.h"
 
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <typeinfo>
 #include <vector>
 #include <wx/glcanvas.h>
@@ -128,7 +130,10 @@ class VideoDisplay final : public wxGLCanvas {
 	bool freeSize;
 
 	/// Frame which will replace the currently visible frame on the next render
-	std::shared_ptr<VideoFrame> pending_frame;
+	std::shared_ptr<const VideoFrame> pending_frame;
+	/// When the oldest change to the subtitles first shown in pending_frame
+	/// was made, for logging how long changes take to appear
+	std::optional<std::chrono::steady_clock::time_point> pending_changed_at;
 
 	int scale_factor;
 
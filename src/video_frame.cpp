@@ -16,7 +16,10 @@
 
 #include "video_frame.h"
 
+#include "include/aegisub/video_provider.h"
+
 #include <boost/gil.hpp>
+#include <mutex>
 #include <wx/image.h>
 
 namespace {
@@ -33,6 +36,46 @@ namespace {
 	};
 }
 
+struct VideoFramePool::FreeList {
+	std::mutex lock;
+	std::vector<std::unique_ptr<VideoFrame>> frames;
+	size_t max_free;
+};
+
+VideoFramePool::VideoFramePool(size_t max_free)
+: free(std::make_shared<FreeList>())
+{
+	free->max_free = max_free;
+}
+
+VideoFramePool::~VideoFramePool() = default;
+
+std::shared_ptr<VideoFrame> VideoFramePool::Get() {
+	std::unique_ptr<VideoFrame> frame;
+	{
+		std::lock_guard<std::mutex> guard(free->lock);
+		if (!free->frames.empty()) {
+			frame = std::move(free->frames.back());
+			free->frames.pop_back();
+		}
+	}
+	if (!frame)
+		frame = std::make_unique<VideoFrame>();
+
+	return std::shared_ptr<VideoFrame>(frame.release(), [free = free](VideoFrame *released) {
+		std::unique_ptr<VideoFrame> owned(released);
+		std::lock_guard<std::mutex> guard(free->lock);
+		if (free->frames.size() < free->max_free)
+			free->frames.push_back(std::move(owned));
+	});
+}
+
+std::shared_ptr<const VideoFrame> VideoProvider::GetSharedFrame(int n, VideoFramePool &pool) {
+	auto frame = pool.Get();
+	GetFrame(n, *frame);
+	return frame;
+}
+
 wxImage GetImage(VideoFrame const& frame) {
 	using namespace boost::gil;
 
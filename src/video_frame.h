@@ -14,7 +14,10 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
 #include <stddef.h>
+#include <memory>
 #include <vector>
 
 class wxImage;
@@ -27,5 +30,26 @@ struct VideoFrame {
 	bool flipped;
 };
 
+/// @class VideoFramePool
+/// @brief Recycles the buffers of video frames which are no longer in use
+///
+/// Frames handed out by the pool are reference counted, and their storage
+/// goes back to the pool when the last reference is dropped, so decoding into
+/// a frame from the pool doesn't need to allocate once the pool has warmed
+/// up. Frames may be obtained and released from any thread, and may outlive
+/// the pool.
+class VideoFramePool {
+	struct FreeList;
+	std::shared_ptr<FreeList> free;
+
+public:
+	/// @param max_free Maximum number of unused frames to keep around
+	VideoFramePool(size_t max_free = 4);
+	~VideoFramePool();
+
+	/// Get a frame, which may have the contents of a previously released one
+	std::shared_ptr<VideoFrame> Get();
+};
+
 wxImage GetImage(VideoFrame const& frame);
 wxImage GetImageWithAlpha(VideoFrame const& frame);
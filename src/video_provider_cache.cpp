@@ -19,43 +19,111 @@
 #include "options.h"
 #include "video_frame.h"
 
+#include <libaegisub/log.h>
 
+#include <algorithm>
 #include <list>
+#include <unordered_map>
 
 namespace {
 /// A video frame and its frame number
 struct CachedFrame {
-	VideoFrame frame;
+	/// The frame, which may also be in use outside of the cache
+	std::shared_ptr<const VideoFrame> frame;
 	int frame_number;
-
-	CachedFrame(VideoFrame const& frame, int frame_number)
-	: frame(frame), frame_number(frame_number) { }
-
-	CachedFrame(CachedFrame const&) = delete;
+	/// Is this frame in the pinned list rather than the LRU list?
+	bool pinned;
 };
 
 /// @class VideoProviderCache
 /// @brief A wrapper around a video provider which provides LRU caching
+///
+/// Keyframes are pinned, i.e. kept regardless of how recently they were
+/// used, until they take up a quarter of the cache. Seeking usually lands on
+/// them, and they're the most expensive frames to get back from the decoder
+/// after a seek.
+///
+/// Cached frames are handed out by reference rather than copied, so they must
+/// never be modified.
 class VideoProviderCache final : public VideoProvider {
+	using FrameList = std::list<CachedFrame>;
+
 	/// The source provider to get frames from
 	std::unique_ptr<VideoProvider> master;
 
-	/// @brief Maximum size of the cache in bytes
-	///
-	/// Note that this is a soft limit. The cache stops allocating new frames
-	/// once it has exceeded the limit, but it never tries to shrink
+	/// Maximum size of the cache in bytes
 	const size_t max_cache_size = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20; // convert MB to bytes
 
-	/// Cache of video frames with the most recently used ones at the front
-	std::list<CachedFrame> cache;
+	/// Maximum size of the pinned frames in bytes
+	const size_t max_pinned_size = max_cache_size / 4;
+
+	/// Sorted frame numbers of the keyframes
+	const std::vector<int> keyframes;
+
+	/// Unpinned frames with the most recently used ones at the front
+	FrameList cache;
+
+	/// Pinned frames with the most recently used ones at the front
+	FrameList pinned;
+
+	/// Frame number to its entry in cache or pinned
+	std::unordered_map<int, FrameList::iterator> index;
+
+	/// Total size of the frames in cache and pinned
+	size_t cache_size = 0;
+
+	/// Total size of the frames in pinned
+	size_t pinned_size = 0;
+
+	/// Size of the most recently decoded frame, which all others should match
+	size_t frame_size = 0;
+
+	/// Number of requests satisfied from the cache
+	size_t hits = 0;
+	/// Number of requests which had to go to the master provider
+	size_t misses = 0;
+	/// Number of frames dropped to stay within the size limit
+	size_t evictions = 0;
+	/// Number of frames decoded ahead of being requested
+	size_t prefetched = 0;
+
+	/// Should frame n of the given size be pinned?
+	bool ShouldPin(int n, size_t size) const {
+		return pinned_size + size <= max_pinned_size && std::binary_search(keyframes.begin(), keyframes.end(), n);
+	}
+
+	/// Drop unpinned frames, least recently used first, until there's room
+	/// for size more bytes
+	void Evict(size_t size);
+
+	/// Decode a frame which isn't in the cache and add it if there's room
+	std::shared_ptr<const VideoFrame> Decode(int n, VideoFramePool &pool);
+
+	void Clear() {
+		cache.clear();
+		pinned.clear();
+		index.clear();
+		cache_size = pinned_size = 0;
+	}
 
 public:
-	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
+	VideoProviderCache(std::unique_ptr<VideoProvider> master)
+	: master(std::move(master))
+	, keyframes(this->master->GetKeyFrames())
+	{
+	}
+
+	~VideoProviderCache() {
+		LOG_I("video/cache") << "hits: " << hits << " misses: " << misses << " evictions: " << evictions << " prefetched: " << prefetched
+			<< " frames: " << index.size() << " pinned: " << pinned.size() << " bytes: " << cache_size;
+	}
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	std::shared_ptr<const VideoFrame> GetSharedFrame(int n, VideoFramePool &pool) override;
+	bool PrefetchFrame(int n, int distance, VideoFramePool &pool) override;
 
 	void SetColorSpace(agi::ycbcr::Header m) override {
-		cache.clear();
+		Clear();
 		return master->SetColorSpace(m);
 	}
 
@@ -64,7 +132,7 @@ public:
 	int GetHeight() const override                 { return master->GetHeight(); }
 	double GetDAR() const override                 { return master->GetDAR(); }
 	agi::vfr::Framerate GetFPS() const override    { return master->GetFPS(); }
-	std::vector<int> GetKeyFrames() const override { return master->GetKeyFrames(); }
+	std::vector<int> GetKeyFrames() const override { return keyframes; }
 	std::string GetWarning() const override        { return master->GetWarning(); }
 	std::string GetDecoderName() const override    { return master->GetDecoderName(); }
 	agi::ycbcr::header_colorspace GetColorSpace() const override     { return master->GetColorSpace(); }
@@ -74,28 +142,66 @@ public:
 	bool HasAudio() const override                 { return master->HasAudio(); }
 };
 
-void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+void VideoProviderCache::Evict(size_t size) {
+	while (!cache.empty() && cache_size + size > max_cache_size) {
+		auto const& last = cache.back();
+		cache_size -= last.frame->data.size();
+		index.erase(last.frame_number);
+		cache.pop_back();
+		++evictions;
+	}
+}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+std::shared_ptr<const VideoFrame> VideoProviderCache::Decode(int n, VideoFramePool &pool) {
+	auto frame = pool.Get();
+	master->GetFrame(n, *frame);
+
+	const size_t size = frame_size = frame->data.size();
+	const bool pin = ShouldPin(n, size);
+	if (!pin && size > max_cache_size - std::min(max_cache_size, pinned_size))
+		return frame;
+
+	Evict(size);
+	auto& list = pin ? pinned : cache;
+	list.push_front(CachedFrame{frame, n, pin});
+	index[n] = list.begin();
+	cache_size += size;
+	if (pin)
+		pinned_size += size;
+	return frame;
+}
 
-		total_size += cur->frame.data.size();
+std::shared_ptr<const VideoFrame> VideoProviderCache::GetSharedFrame(int n, VideoFramePool &pool) {
+	auto it = index.find(n);
+	if (it != index.end()) {
+		auto& list = it->second->pinned ? pinned : cache;
+		list.splice(list.begin(), list, it->second); // Move to front
+		++hits;
+		return it->second->frame;
 	}
 
-	master->GetFrame(n, out);
+	++misses;
+	return Decode(n, pool);
+}
 
-	if (total_size >= max_cache_size) {
-		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
-		cache.front().frame_number = n;
-		cache.front().frame = out;
-	}
-	else
-		cache.emplace_front(out, n);
+void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
+	// Only for callers which want their own copy of the frame
+	VideoFramePool pool(0);
+	out = *GetSharedFrame(n, pool);
+}
+
+bool VideoProviderCache::PrefetchFrame(int n, int distance, VideoFramePool &pool) {
+	if (index.count(n))
+		return true;
+
+	// Only read ahead as far as the cache can hold without evicting the
+	// frames read ahead of this one or the one being displayed
+	if (frame_size == 0 || (distance + 1) * frame_size > max_cache_size - std::min(max_cache_size, pinned_size))
+		return false;
+
+	++prefetched;
+	Decode(n, pool);
+	return true;
 }
 }
 
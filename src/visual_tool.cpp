@@ -35,6 +35,7 @@
 #include <libaegisub/string.h>
 
 #include <algorithm>
+#include <wx/display.h>
 
 VisualToolBase::VisualToolBase(VideoDisplay *parent, agi::Context *context)
 : c(context)
@@ -51,7 +52,13 @@ VisualToolBase::VisualToolBase(VideoDisplay *parent, agi::Context *context)
 	active_line = GetActiveDialogueLine();
 	connections.push_back(c->selectionController->AddActiveLineListener(&VisualToolBase::OnActiveLineChanged, this));
 	connections.push_back(c->videoController->AddSeekListener(&VisualToolBase::OnSeek, this));
+	connections.push_back(c->ass->AddPrepareCommitListener(&VisualToolBase::OnPrepareCommit, this));
 	parent->Bind(wxEVT_MOUSE_CAPTURE_LOST, &VisualToolBase::OnMouseCaptureLost, this);
+
+	int display_index = wxDisplay::GetFromWindow(parent);
+	int refresh = wxDisplay(display_index == wxNOT_FOUND ? 0 : display_index).GetCurrentMode().GetRefresh();
+	preview_interval = std::chrono::microseconds(1000000 / (refresh > 0 ? refresh : 60));
+	preview_timer.Bind(wxEVT_TIMER, [this](wxTimerEvent&) { SendPreview(); });
 }
 
 void VisualToolBase::SetResolutions() {
@@ -62,6 +69,16 @@ void VisualToolBase::SetResolutions() {
 	layout_res = Vector2D(layout_w, layout_h);
 }
 
+void VisualToolBase::OnPrepareCommit(int type) {
+	// Undo only records what each commit says it changed, so the lines being
+	// previewed have to be committed first for the changes not to be lost.
+	// A new file replaces the lines entirely, so there's nothing to keep.
+	if (type == AssFile::COMMIT_NEW)
+		ClearPreview();
+	else
+		FinishPreview();
+}
+
 void VisualToolBase::OnCommit(int type) {
 	holding = false;
 	dragging = false;
@@ -85,6 +102,7 @@ void VisualToolBase::OnSeek(int new_frame) {
 
 	AssDialogue *new_line = GetActiveDialogueLine();
 	if (new_line != active_line) {
+		FinishPreview();
 		dragging = false;
 		active_line = new_line;
 		OnLineChanged();
@@ -92,6 +110,7 @@ void VisualToolBase::OnSeek(int new_frame) {
 }
 
 void VisualToolBase::OnMouseCaptureLost(wxMouseCaptureLostEvent &) {
+	FinishPreview();
 	holding = false;
 	dragging = false;
 }
@@ -100,6 +119,7 @@ void VisualToolBase::OnActiveLineChanged(AssDialogue *new_line) {
 	if (!IsDisplayed(new_line))
 		new_line = nullptr;
 
+	FinishPreview();
 	holding = false;
 	dragging = false;
 	if (new_line != active_line) {
@@ -118,6 +138,8 @@ bool VisualToolBase::IsDisplayed(AssDialogue *line) const {
 }
 
 void VisualToolBase::Commit(wxString message) {
+	ClearPreview();
+
 	file_changed_connection.Block();
 	if (message.empty())
 		message = _("visual typesetting");
@@ -126,6 +148,47 @@ void VisualToolBase::Commit(wxString message) {
 	file_changed_connection.Unblock();
 }
 
+void VisualToolBase::Preview() {
+	preview_pending = true;
+	auto now = std::chrono::steady_clock::now();
+	if (!preview_since)
+		preview_since = now;
+
+	// Mouse events can arrive much faster than frames can be shown, so send
+	// at most one preview per refresh of the display
+	if (preview_timer.IsRunning()) return;
+	auto wait = last_preview + preview_interval - now;
+	if (wait <= wait.zero())
+		SendPreview();
+	else
+		preview_timer.StartOnce(static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count()));
+}
+
+void VisualToolBase::SendPreview() {
+	if (!preview_since) return;
+
+	std::vector<const AssDialogue *> lines;
+	auto const& sel = c->selectionController->GetSelectedSet();
+	lines.assign(sel.begin(), sel.end());
+	if (active_line && !sel.count(active_line))
+		lines.push_back(active_line);
+
+	c->videoController->PreviewLines(lines, *preview_since);
+	preview_since.reset();
+	last_preview = std::chrono::steady_clock::now();
+}
+
+void VisualToolBase::FinishPreview() {
+	if (preview_pending)
+		Commit();
+}
+
+void VisualToolBase::ClearPreview() {
+	preview_pending = false;
+	preview_since.reset();
+	preview_timer.Stop();
+}
+
 AssDialogue* VisualToolBase::GetActiveDialogueLine() {
 	AssDialogue *diag = c->selectionController->GetActiveLine();
 	if (IsDisplayed(diag))
@@ -143,6 +206,7 @@ void VisualToolBase::SetDisplayArea(int x, int y, int w, int h) {
 	video_pos = Vector2D(x, y);
 	video_size = Vector2D(w, h);
 
+	FinishPreview();
 	holding = false;
 	dragging = false;
 	if (parent->HasCapture())
@@ -198,11 +262,12 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 				sel->UpdateDrag(mouse_pos - drag_start, shift_down);
 			for (auto sel : sel_features)
 				UpdateDrag(sel);
-			Commit();
+			Preview();
 		}
 		// end drag
 		else {
 			dragging = false;
+			FinishPreview();
 
 			// mouse didn't move, fiddle with selection
 			if (active_feature && !active_feature->HasMoved()) {
@@ -229,7 +294,10 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 		}
 
 		UpdateHold();
-		Commit();
+		if (holding)
+			Preview();
+		else
+			Commit();
 
 	}
 	else if (left_click) {
@@ -23,7 +23,10 @@
 #include <libaegisub/owning_intrusive_list.h>
 #include <libaegisub/signal.h>
 
+#include <chrono>
+#include <optional>
 #include <set>
+#include <wx/timer.h>
 
 class AssDialogue;
 class VideoDisplay;
@@ -44,11 +47,18 @@ namespace agi {
 /// of each method for no good reason (and four times as many error messages)
 class VisualToolBase {
 	void SetResolutions();
+	void OnPrepareCommit(int type);
 	void OnCommit(int type);
 	void OnSeek(int new_frame);
 
 	void OnMouseCaptureLost(wxMouseCaptureLostEvent &);
 
+	/// Send the lines being edited to the video, if they've changed since
+	/// they were last sent
+	void SendPreview();
+	/// Forget about any changes being previewed
+	void ClearPreview();
+
 	/// @brief Get the dialogue line currently in the edit box
 	/// @return nullptr if the line is not active on the current frame
 	AssDialogue *GetActiveDialogueLine();
@@ -113,9 +123,23 @@ protected:
 	agi::signal::Connection file_changed_connection;
 	int commit_id = -1; ///< Last used commit id for coalescing
 
+	bool preview_pending = false; ///< Have lines been changed by a drag or hold without committing them?
+	std::optional<std::chrono::steady_clock::time_point> preview_since; ///< Time of the oldest change not yet sent to the video
+	std::chrono::steady_clock::time_point last_preview; ///< When the video was last sent the lines being edited
+	std::chrono::microseconds preview_interval; ///< Minimum time between previews, which is the display's refresh interval
+	wxTimer preview_timer; ///< Sends changes which arrived too soon after the previous preview
+
 	/// @brief Commit the current file state
 	/// @param message Description of changes for undo
 	virtual void Commit(wxString message = wxString());
+
+	/// @brief Show the current state of the lines being edited on the video
+	///
+	/// Drags and holds use this rather than committing on every mouse move,
+	/// as a commit updates everything which displays the file. The changes
+	/// are committed once the drag or hold ends.
+	virtual void Preview();
+
 	bool IsDisplayed(AssDialogue *line) const;
 
 	/// Get the line's position if it's set, or it's default based on style if not
@@ -150,6 +174,9 @@ public:
 	virtual void SetToolbar(wxToolBar *) { }
 	virtual void SetSubTool([[maybe_unused]] int subtool) { }
 	virtual int GetSubTool() { return 0; }
+	/// Commit the changes from a drag or hold which ended without committing,
+	/// which must be done before the tool is destroyed
+	void FinishPreview();
 	virtual ~VisualToolBase() = default;
 };
 
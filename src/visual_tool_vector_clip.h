@@ -56,6 +56,7 @@ class VisualToolVectorClip final : public VisualTool<VisualToolVectorClipDraggab
 
 	void Save();
 	void Commit(wxString message="") override;
+	void Preview() override;
 
 	void AddTool(std::string command_name, VisualToolVectorClipMode mode);
 
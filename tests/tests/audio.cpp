@@ -16,12 +16,15 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
+#include <atomic>
 #include <fstream>
+#include <thread>
 
 TEST(lagi_audio, dummy_blank) {
 	auto provider = agi::CreateDummyAudioProvider("dummy-audio:", nullptr);
@@ -225,6 +228,159 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, hd_cache_concurrent_reads) {
+	auto provider = agi::CreateHDAudioProvider(std::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	std::atomic<int> mismatches{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t] {
+			uint16_t buff[512];
+			for (int64_t start = t * 4096; start + 512 < provider->GetNumSamples(); start += 1 << 18) {
+				provider->GetAudio(buff, start, 512);
+				for (size_t i = 0; i < 512; ++i) {
+					if (buff[i] != static_cast<uint16_t>(start + i))
+						++mismatches;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(0, mismatches);
+}
+
+static agi::AudioPeak scalar_peak(const int16_t *samples, int64_t count) {
+	int peak_min = 0, peak_max = 0;
+	int64_t sum_min = 0, sum_max = 0;
+	for (int64_t i = 0; i < count; ++i) {
+		if (samples[i] > 0) {
+			peak_max = std::max<int>(peak_max, samples[i]);
+			sum_max += samples[i];
+		}
+		else {
+			peak_min = std::min<int>(peak_min, samples[i]);
+			sum_min += samples[i];
+		}
+	}
+	agi::AudioPeak ret;
+	ret.min = peak_min;
+	ret.max = peak_max;
+	ret.avg_min = sum_min / count;
+	ret.avg_max = sum_max / count;
+	return ret;
+}
+
+TEST(lagi_audio, compute_peak_matches_scalar) {
+	std::vector<int16_t> samples(300000);
+	uint32_t state = 1;
+	for (auto& sample : samples) {
+		state = state * 1103515245 + 12345;
+		sample = static_cast<int16_t>(state >> 16);
+	}
+	samples[17] = SHRT_MIN;
+	samples[200001] = SHRT_MAX;
+
+	for (int64_t count : {1, 7, 8, 9, 256, 1000, 299999}) {
+		auto expected = scalar_peak(&samples[1], count);
+		auto actual = agi::ComputeAudioPeak(&samples[1], count);
+		EXPECT_EQ(expected.min, actual.min) << count;
+		EXPECT_EQ(expected.max, actual.max) << count;
+		EXPECT_EQ(expected.avg_min, actual.avg_min) << count;
+		EXPECT_EQ(expected.avg_max, actual.avg_max) << count;
+	}
+}
+
+TEST(lagi_audio, peak_pyramid) {
+	const int64_t num_samples = 100000;
+	std::vector<int16_t> samples(num_samples);
+	for (int64_t i = 0; i < num_samples; ++i)
+		samples[i] = static_cast<int16_t>((i % 1000) - 500);
+	samples[5000] = 20000;
+	samples[70000] = -20000;
+
+	agi::AudioPeakPyramid pyramid(num_samples);
+	EXPECT_EQ(0, pyramid.GetReadySamples());
+
+	// Uneven chunks to exercise the partial bucket handling
+	pyramid.Add(samples.data(), 1000);
+	EXPECT_EQ(768, pyramid.GetReadySamples());
+	pyramid.Add(samples.data() + 1000, 59000);
+	EXPECT_EQ(59904, pyramid.GetReadySamples());
+
+	// Unready samples are silence
+	auto peak = pyramid.Get(60000, num_samples);
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(0, peak.max);
+
+	pyramid.Add(samples.data() + 60000, num_samples - 60000);
+	EXPECT_EQ(num_samples, pyramid.GetReadySamples());
+
+	peak = pyramid.Get(0, num_samples);
+	EXPECT_EQ(-20000, peak.min);
+	EXPECT_EQ(20000, peak.max);
+
+	peak = pyramid.Get(4096, 8192);
+	EXPECT_EQ(-500, peak.min);
+	EXPECT_EQ(20000, peak.max);
+
+	// The final partial bucket is included
+	peak = pyramid.Get(num_samples - 100, num_samples);
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(499, peak.max);
+
+	peak = pyramid.Get(0, 256);
+	auto expected = agi::ComputeAudioPeak(samples.data(), 256);
+	EXPECT_EQ(expected.min, peak.min);
+	EXPECT_EQ(expected.max, peak.max);
+	EXPECT_EQ(expected.avg_min, peak.avg_min);
+	EXPECT_EQ(expected.avg_max, peak.avg_max);
+}
+
+TEST(lagi_audio, peak_pyramid_save_load) {
+	auto path = agi::Path().Decode("?temp/peaks");
+	const int64_t num_samples = 10000;
+	std::vector<int16_t> samples(num_samples);
+	for (int64_t i = 0; i < num_samples; ++i)
+		samples[i] = static_cast<int16_t>(i * 7);
+
+	agi::AudioPeakPyramid pyramid(num_samples);
+	pyramid.Add(samples.data(), num_samples / 2);
+	EXPECT_FALSE(pyramid.Save(path));
+	pyramid.Add(samples.data() + num_samples / 2, num_samples / 2);
+	ASSERT_TRUE(pyramid.Save(path));
+
+	EXPECT_EQ(nullptr, agi::AudioPeakPyramid::Load(path, num_samples + 1));
+
+	auto loaded = agi::AudioPeakPyramid::Load(path, num_samples);
+	ASSERT_NE(nullptr, loaded);
+	EXPECT_EQ(num_samples, loaded->GetReadySamples());
+	for (int64_t start : {0, 300, 5000}) {
+		auto expected = pyramid.Get(start, start + 2000);
+		auto actual = loaded->Get(start, start + 2000);
+		EXPECT_EQ(expected.min, actual.min);
+		EXPECT_EQ(expected.max, actual.max);
+		EXPECT_EQ(expected.avg_min, actual.avg_min);
+		EXPECT_EQ(expected.avg_max, actual.avg_max);
+	}
+
+	agi::fs::Remove(path);
+	EXPECT_EQ(nullptr, agi::AudioPeakPyramid::Load(path, num_samples));
+}
+
+TEST(lagi_audio, ram_cache_peaks) {
+	auto provider = agi::CreateRAMAudioProvider(std::make_unique<TestAudioProvider<int16_t>>(10));
+	auto peaks = provider->GetPeaks();
+	ASSERT_NE(nullptr, peaks);
+	while (peaks->GetReadySamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto peak = peaks->Get(0, 65536);
+	EXPECT_EQ(SHRT_MIN, peak.min);
+	EXPECT_EQ(SHRT_MAX, peak.max);
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(std::make_unique<TestAudioProvider<uint8_t>>());
 
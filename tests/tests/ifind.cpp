@@ -65,6 +65,17 @@ TEST(lagi_ifind, no_partial_match_on_decomposed_character) {
 	EXPECT_IFIND("\xEF\xAC\x86", "st", 0, 3);
 }
 
+TEST(lagi_ifind, ascii_haystack) {
+	EXPECT_IFIND("Some Text", "TEXT", 5, 9);
+	EXPECT_IFIND("Some Text", "", 0, 0);
+	EXPECT_NO_MATCH("Some Text", "t\xC3\xA9xt");
+	// KELVIN SIGN and LATIN SMALL LETTER LONG S fold to ASCII letters
+	EXPECT_IFIND(" k ", "\xE2\x84\xAA", 1, 2);
+	EXPECT_IFIND("Mass", "ma\xC5\xBFs", 0, 4);
+	// So does LATIN SMALL LETTER SHARP S, to two of them
+	EXPECT_IFIND("Mass", "\xC3\x9F", 2, 4);
+}
+
 TEST(lagi_ifind, correct_index_with_expanded_character_before_match) {
 	// U+0587 turns into U+0565 U+0582, all of which are two bytes in UTF-8
 	EXPECT_IFIND(" \xD6\x87 a ", "a", 4, 5);